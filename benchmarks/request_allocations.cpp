@@ -0,0 +1,167 @@
+/*
+ * Count the heap allocations made by the server while handling read, write and consent requests
+ * on files it already knows, which is the path taken by most requests of a running workflow.
+ * Handlers are run in place, without dispatch and probe workers, on requests encoded as clients
+ * do. The benchmark fails if any of these requests allocates.
+ *
+ * Usage: capio_request_allocations [iterations]
+ */
+#include <climits>
+#include <singleheader/simdjson.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <string>
+
+std::string workflow_name;
+char node_name[HOST_NAME_MAX];
+
+#include "utils/types.hpp"
+
+#include "capio/env.hpp"
+#include "capio/logger.hpp"
+#include "utils/common.hpp"
+
+#include "client-manager/request_handler_engine.hpp"
+#include "file-manager/file_manager.hpp"
+
+static std::atomic<unsigned long long> allocations{0};
+
+void *operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+void operator delete[](void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+/**
+ * Encode a request of type Req from @param req and @param strs, and run @param handler on it
+ * @param iterations times, reading the reply from @param mailbox if the request has one
+ * @param name
+ * @param req
+ * @param strs
+ * @param mailbox
+ * @param replies
+ * @param iterations
+ * @return the heap allocations per request
+ */
+template <class Req, void (*handler)(const CapioRequestView<Req> &)>
+static double run(const char *name, Req req, const CapioRequestStrings<Req> &strs,
+                  CapioMailbox *mailbox, bool replies, long iterations) {
+    std::vector<char> buf(capio_request_size<Req>(strs));
+    capio_encode_request(buf.data(), req, strs);
+    CapioRequestView<Req> request{};
+    if (!capio_decode_request(buf.data(), static_cast<long int>(buf.size()), &request)) {
+        std::cerr << "Unable to decode " << name << " request" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // the first request fills the state of the server for the file
+    handler(request);
+    request_arena.reset();
+    if (replies) {
+        MailboxSlab::wait(mailbox);
+    }
+
+    const unsigned long long before = allocations.load();
+    const auto start                = std::chrono::steady_clock::now();
+    for (long i = 0; i < iterations; ++i) {
+        handler(request);
+        // as done by the server after every dispatch
+        request_arena.reset();
+        if (replies) {
+            MailboxSlab::wait(mailbox);
+        }
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    const double per_request =
+        static_cast<double>(allocations.load() - before) / static_cast<double>(iterations);
+
+    std::cout << name << ": " << per_request << " allocations per request, "
+              << std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / iterations
+              << " ns per request" << std::endl;
+    return per_request;
+}
+
+int main(int argc, char **argv) {
+    const long iterations = argc > 1 ? std::strtol(argv[1], nullptr, 10) : 100000;
+    gethostname(node_name, HOST_NAME_MAX);
+
+    // handlers run on this thread, and replies are read back from its mailbox
+    setenv("CAPIO_DISPATCH_WORKERS", "0", 1);
+    setenv("CAPIO_PROBE_WORKERS", "0", 1);
+    const bool own_dir = std::getenv("CAPIO_DIR") == nullptr;
+    if (own_dir) {
+        char dir[] = "/tmp/capio_request_allocations_XXXXXX";
+        if (mkdtemp(dir) == nullptr) {
+            std::cerr << "Unable to create CAPIO_DIR" << std::endl;
+            return EXIT_FAILURE;
+        }
+        setenv("CAPIO_DIR", dir, 1);
+    }
+    workflow_name = "request_allocations_" + std::to_string(getpid());
+    setenv("CAPIO_WORKFLOW_NAME", workflow_name.c_str(), 1);
+
+    capio_cl_engine         = JsonParser::parse("");
+    file_manager            = new CapioFileManager();
+    request_handlers_engine = new RequestHandlerEngine();
+
+    const pid_t tid = gettid();
+    auto mailboxes  = new MailboxSlab(CAPIO_MAILBOX_SLAB_SIZE, workflow_name, false);
+    const int index = mailboxes->claim(tid);
+    auto mailbox    = mailboxes->at(index, tid);
+    client_manager->register_new_client(tid, index, "request_allocations");
+
+    // a committed file, and a file still being written, both holding the data read
+    const std::string path    = get_capio_dir() / "request_allocations_input.dat";
+    const std::string partial = get_capio_dir() / "request_allocations_partial.dat";
+    std::ofstream(path) << std::string(4096, 'x');
+    std::ofstream(partial) << std::string(4096, 'x');
+    file_manager->setCommitted(path);
+
+    ReadRequest read{};
+    read.header.tid  = tid;
+    read.end_of_read = 4096;
+    WriteRequest write{};
+    write.header.tid = tid;
+    write.write_size = 4096;
+    ConsentRequest consent{};
+    consent.header.tid = tid;
+
+    double allocated = 0;
+    allocated += run<ReadRequest, read_handler>("read", read, {path}, mailbox, true, iterations);
+    allocated += run<ReadRequest, read_handler>("read (not committed)", read, {partial}, mailbox,
+                                                true, iterations);
+    allocated +=
+        run<WriteRequest, write_handler>("write", write, {path}, mailbox, false, iterations);
+    allocated += run<ConsentRequest, consent_to_proceed_handler>(
+        "consent", consent, {path, "request_allocations"}, mailbox, true, iterations);
+
+    delete request_handlers_engine;
+    delete file_manager;
+    delete mailboxes;
+    std::filesystem::remove(path);
+    std::filesystem::remove(partial);
+    if (own_dir) {
+        std::filesystem::remove_all(get_capio_dir());
+    }
+
+    return allocated == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -33,22 +33,24 @@ int main(int argc, char *argv[]) {
 
     // check canary of capio server
 
-    if (shm_open(get_capio_workflow_name().c_str(), O_RDONLY, 0) == -1) {
+    if (capio_shm_open(get_capio_workflow_name(), O_RDONLY, 0) == -1) {
         std::cout << "No capio instances found for workflow " << get_capio_workflow_name()
                   << "! Aborting" << std::endl;
         exit(EXIT_FAILURE);
     }
 
-    auto tx = new CircularBuffer<char>("RX", CAPIO_REQ_BUFF_CNT, CAPIO_REQ_MAX_SIZE, workflow_name,
-                                       false);
+    auto tx = new CircularBuffer<char>("RX", CAPIO_REQ_BUFF_CNT, CAPIO_CTL_MSG_MAX_SIZE,
+                                       workflow_name, false);
 
-    auto rx = new CircularBuffer<char>("TX", CAPIO_REQ_BUFF_CNT, CAPIO_REQ_MAX_SIZE, workflow_name,
-                                       false);
+    auto rx = new CircularBuffer<char>("TX", CAPIO_REQ_BUFF_CNT, CAPIO_CTL_MSG_MAX_SIZE,
+                                       workflow_name, false);
 
     args::ArgumentParser parser("Parser for capioctl");
     args::Group commands(parser, "commands");
     args::Command get(commands, "get", "Retrieve information's on object");
     args::Command set(commands, "set", "Configure the CAPIO server");
+    args::Command stats(commands, "stats",
+                        "Print the latency of the requests handled by the server, by request type");
 
     args::ValueFlag<std::string> apps(
         get, "apps", "[ all , ... ]List the currently registered apps with CAPIO", {"apps"});
@@ -86,13 +88,17 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    tx->write("CIAO PIPPO");
+    if (stats) {
+        char request[CAPIO_CTL_MSG_MAX_SIZE]{};
+        strncpy(request, CAPIO_CTL_REQUEST_STATS, CAPIO_CTL_MSG_MAX_SIZE - 1);
+        tx->write(request);
 
-    char result[256];
-
-    rx->read(result);
-
-    std::cout << result << std::endl;
+        // the server ends its reply with an empty line
+        char result[CAPIO_CTL_MSG_MAX_SIZE];
+        for (rx->read(result); result[0] != '\0'; rx->read(result)) {
+            std::cout << result << std::endl;
+        }
+    }
 
     delete tx;
     delete rx;
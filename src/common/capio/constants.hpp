@@ -19,6 +19,9 @@ constexpr std::array CAPIO_DIR_FORBIDDEN_PATHS    = {std::string_view{"/proc/"},
 // CAPIO default values for shared memory
 constexpr char CAPIO_DEFAULT_WORKFLOW_NAME[] = "CAPIO";
 constexpr char CAPIO_DEFAULT_APP_NAME[]      = "default_app";
+constexpr int CAPIO_SHM_NUMA_NODE_NONE       = -1;   // Shared memory is placed on first touch
+constexpr int CAPIO_SHM_NUMA_NODE_AUTO       = -2;   // Node of the server thread creating it
+constexpr int CAPIO_SHM_NUMA_MAX_NODES       = 1024; // Size of the node mask passed to mbind
 constexpr char CAPIO_SHM_CANARY_ERROR[] =
     "FATAL ERROR:  Shared memories for workflow %s already "
     "exists. One of two (or both) reasons are to blame: \n             "
@@ -30,7 +33,31 @@ constexpr char CAPIO_SHM_CANARY_ERROR[] =
 constexpr int CAPIO_REQ_BUFF_CNT                     = 512; // Max number of elements inside buffers
 constexpr int CAPIO_CACHE_LINES_DEFAULT              = 10;
 constexpr int CAPIO_CACHE_LINE_SIZE_DEFAULT          = 4096;
-constexpr size_t CAPIO_REQ_MAX_SIZE                  = 256 * sizeof(char);
+constexpr size_t CAPIO_REQ_MAX_SIZE                  = 2 * PATH_MAX + 256; // Max size of a request
+constexpr long int CAPIO_REQ_RING_SIZE               = 512 * 1024;         // Multiple of page size
+constexpr size_t CAPIO_CTL_MSG_MAX_SIZE              = 256 * sizeof(char);
+constexpr char CAPIO_CTL_REQUEST_STATS[]             = "stats"; // Latency of requests, by code
+constexpr int CAPIO_MAILBOX_SLAB_SIZE                = 4096; // Max number of client threads
+constexpr int CAPIO_WAKE_BOARD_SLOTS                 = 8192; // Files threads wait for together
+constexpr int CAPIO_WAKE_BOARD_PROBES                = 64;   // Slots where a file can be found
+constexpr long int CAPIO_REQ_BATCH_SIZE_DEFAULT      = 4096; // Bytes staged before a flush
+constexpr long int CAPIO_REQ_BATCH_MAX_AGE_DEFAULT   = 1000; // Microseconds staged before a flush
+constexpr long int CAPIO_SPIN_TIME_DEFAULT           = 50;   // Max microseconds spent spinning
+constexpr unsigned int CAPIO_SPIN_YIELD_PERIOD       = 64;   // Spin iterations between two yields
+constexpr int CAPIO_REQ_PRIORITY_BURST               = 64;   // Blocking requests per shard and pass
+constexpr int CAPIO_REQ_NOTIFICATION_QUANTUM         = 16;   // Notifications per shard and pass
+constexpr int CAPIO_REQ_SHARDS_DEFAULT               = 1;    // Rings requests are spread on
+constexpr int CAPIO_REQ_SHARDS_MAX                   = 256;  // Max number of request shards
+constexpr int CAPIO_DISPATCH_WORKERS_DEFAULT         = 4;    // Threads running request handlers
+constexpr int CAPIO_DISPATCH_WORKERS_MAX             = 64;   // Max number of dispatch workers
+constexpr int CAPIO_DISPATCH_QUEUE_DEPTH             = 256;  // Requests queued on each worker
+constexpr int CAPIO_PROBE_WORKERS_DEFAULT            = 8;    // Threads probing the file system
+constexpr int CAPIO_PROBE_WORKERS_MAX                = 256;  // Max number of probe workers
+constexpr int CAPIO_PROBE_QUEUE_DEPTH                = 1024; // Probes waiting for a worker
+constexpr int CAPIO_FS_POLL_INTERVAL_DEFAULT         = 300;  // Milliseconds between two polls
+constexpr int CAPIO_FS_POLL_INTERVAL_MAX             = 5000; // Between two polls finding no change
+constexpr unsigned int CAPIO_FS_STATX_BATCH          = 256;  // Paths probed by one io_uring submit
+constexpr int CAPIO_DIR_RESCAN_INTERVAL              = 5000; // Milliseconds between two dir scans
 constexpr char CAPIO_SERVER_CLI_LOG_SERVER[]         = "[ \033[1;32m SERVER \033[0m ] ";
 constexpr char CAPIO_SERVER_CLI_LOG_SERVER_WARNING[] = "[ \033[1;33m SERVER \033[0m ] ";
 constexpr char CAPIO_SERVER_CLI_LOG_SERVER_ERROR[]   = "[ \033[1;31m SERVER \033[0m ] ";
@@ -57,18 +84,27 @@ constexpr int CAPIO_POSIX_SYSCALL_SUCCESS      = 0;
 constexpr char CAPIO_LOG_PRE_MSG[]        = "at[%s]: ";
 constexpr char CAPIO_DEFAULT_LOG_FOLDER[] = "capio_logs\0";
 
+// CAPIO common - shared memory channel layout
+constexpr size_t CAPIO_SHM_CACHE_LINE_SIZE          = 64;
+constexpr unsigned int CAPIO_SHM_CHANNEL_MAGIC      = 0xCA910C4A;
+constexpr unsigned int CAPIO_SHM_CHANNEL_VERSION    = 5;
+constexpr unsigned int CAPIO_SHM_STALE_CHECK_PERIOD = 1024; // Yields between two producer checks
+
+// CAPIO server - commit store, shared by the servers using the same metadata directory
+constexpr char CAPIO_COMMIT_STORE_NAME[]          = "commit_store";
+constexpr unsigned int CAPIO_COMMIT_STORE_MAGIC   = 0xCA91C0DE;
+constexpr unsigned int CAPIO_COMMIT_STORE_VERSION = 1;
+constexpr long CAPIO_COMMIT_STORE_SLOTS_DEFAULT   = 1 << 20; // Files the store can hold
+
 // CAPIO common - shared memory constant names
-constexpr char SHM_FIRST_ELEM[]        = "_first_elem_";
-constexpr char SHM_LAST_ELEM[]         = "_last_elem_";
-constexpr char SHM_MUTEX_PREFIX[]      = "_mutex_";
-constexpr char SHM_SEM_ELEMS[]         = "_sem_num_elems_";
-constexpr char SHM_SEM_EMPTY[]         = "_sem_num_empty_";
 constexpr char SHM_SPSC_PREFIX_WRITE[] = "capio_write_tid_";
 constexpr char SHM_SPSC_PREFIX_READ[]  = "capio_read_tid_";
 
 // CAPIO common - shared channel by client and server
-constexpr char SHM_COMM_CHAN_NAME[]      = "request_buffer";
-constexpr char SHM_COMM_CHAN_NAME_RESP[] = "response_buffer_";
+constexpr char SHM_COMM_CHAN_NAME[]          = "request_buffer";
+constexpr char SHM_COMM_CHAN_NAME_BLOCKING[] = "request_buffer_blocking";
+constexpr char SHM_COMM_CHAN_NAME_RESP[]     = "response_mailboxes";
+constexpr char SHM_WAKE_BOARD_NAME[]         = "wake_board";
 
 // CAPIO logger - shm errors
 constexpr char CAPIO_SHM_OPEN_ERROR[] =
@@ -1,6 +1,7 @@
 #ifndef CAPIO_COMMON_ENV_HPP
 #define CAPIO_COMMON_ENV_HPP
 
+#include <algorithm>
 #include <charconv>
 #include <climits>
 #include <cstdlib>
@@ -54,6 +55,8 @@ inline const std::filesystem::path &get_capio_metadata_path() {
 
         if (val == nullptr) {
             metadata_path = get_capio_dir() / ".capio_metadata";
+        } else {
+            metadata_path = val;
         }
 
         if (!std::filesystem::exists(metadata_path)) {
@@ -94,4 +97,140 @@ inline std::string get_capio_workflow_name() {
     return name;
 }
 
+/**
+ * Number of request shards, taken from CAPIO_REQ_SHARDS. Client threads publish their requests on
+ * the shard of the CPU they run on
+ */
+inline int get_capio_request_shards() {
+    static int shards = 0;
+    if (shards == 0) {
+        const char *val = std::getenv("CAPIO_REQ_SHARDS");
+        shards          = CAPIO_REQ_SHARDS_DEFAULT;
+        if (val != nullptr) {
+            auto [ptr, ec] = std::from_chars(val, val + strlen(val), shards);
+            if (ec != std::errc() || shards < 1) {
+                shards = CAPIO_REQ_SHARDS_DEFAULT;
+            }
+            shards = std::min(shards, CAPIO_REQ_SHARDS_MAX);
+        }
+    }
+    return shards;
+}
+
+/**
+ * Number of server threads running request handlers, taken from CAPIO_DISPATCH_WORKERS. With 0,
+ * requests are handled by the thread reading them from the request channels
+ */
+inline int get_capio_dispatch_workers() {
+    static int workers = -1;
+    if (workers == -1) {
+        const char *val = std::getenv("CAPIO_DISPATCH_WORKERS");
+        workers         = CAPIO_DISPATCH_WORKERS_DEFAULT;
+        if (val != nullptr) {
+            auto [ptr, ec] = std::from_chars(val, val + strlen(val), workers);
+            if (ec != std::errc() || workers < 0) {
+                workers = CAPIO_DISPATCH_WORKERS_DEFAULT;
+            }
+            workers = std::min(workers, CAPIO_DISPATCH_WORKERS_MAX);
+        }
+    }
+    return workers;
+}
+
+/**
+ * Number of server threads running file system probes on behalf of request handlers, taken from
+ * CAPIO_PROBE_WORKERS. With 0, handlers probe the file system themselves
+ */
+inline int get_capio_probe_workers() {
+    static int workers = -1;
+    if (workers == -1) {
+        const char *val = std::getenv("CAPIO_PROBE_WORKERS");
+        workers         = CAPIO_PROBE_WORKERS_DEFAULT;
+        if (val != nullptr) {
+            auto [ptr, ec] = std::from_chars(val, val + strlen(val), workers);
+            if (ec != std::errc() || workers < 0) {
+                workers = CAPIO_PROBE_WORKERS_DEFAULT;
+            }
+            workers = std::min(workers, CAPIO_PROBE_WORKERS_MAX);
+        }
+    }
+    return workers;
+}
+
+/**
+ * Milliseconds between two polls of the files awaited by clients, taken from
+ * CAPIO_FS_POLL_INTERVAL. Polling catches the changes that file system events do not report, such
+ * as the ones made by other nodes on a parallel file system
+ */
+inline int get_capio_fs_poll_interval() {
+    static int interval = 0;
+    if (interval == 0) {
+        const char *val = std::getenv("CAPIO_FS_POLL_INTERVAL");
+        interval        = CAPIO_FS_POLL_INTERVAL_DEFAULT;
+        if (val != nullptr) {
+            auto [ptr, ec] = std::from_chars(val, val + strlen(val), interval);
+            if (ec != std::errc() || interval < 1) {
+                interval = CAPIO_FS_POLL_INTERVAL_DEFAULT;
+            }
+        }
+    }
+    return interval;
+}
+
+/**
+ * Number of files the commit store can hold, taken from CAPIO_COMMIT_STORE_SLOTS and rounded up to
+ * a power of two. Only the server creating the store uses it
+ */
+inline long get_capio_commit_store_slots() {
+    static long slots = 0;
+    if (slots == 0) {
+        const char *val = std::getenv("CAPIO_COMMIT_STORE_SLOTS");
+        slots           = CAPIO_COMMIT_STORE_SLOTS_DEFAULT;
+        if (val != nullptr) {
+            auto [ptr, ec] = std::from_chars(val, val + strlen(val), slots);
+            if (ec != std::errc() || slots < 1) {
+                slots = CAPIO_COMMIT_STORE_SLOTS_DEFAULT;
+            }
+        }
+        long pow2 = 1;
+        while (pow2 < slots) {
+            pow2 <<= 1;
+        }
+        slots = pow2;
+    }
+    return slots;
+}
+
+/**
+ * Mount point of the hugetlbfs file system backing CAPIO shared memory objects, taken from
+ * CAPIO_SHM_HUGETLBFS. Empty if objects are allocated with shm_open on regular pages
+ */
+inline const std::string &get_capio_shm_hugetlbfs_dir() {
+    static const char *val = std::getenv("CAPIO_SHM_HUGETLBFS");
+    static std::string dir = val == nullptr ? "" : val;
+    return dir;
+}
+
+/**
+ * NUMA node the server places CAPIO shared memory objects on, taken from CAPIO_SHM_NUMA_NODE.
+ * "auto" selects the node of the server thread creating the object
+ */
+inline int get_capio_shm_numa_node() {
+    static int node         = CAPIO_SHM_NUMA_NODE_NONE;
+    static bool initialized = false;
+    if (!initialized) {
+        const char *val = std::getenv("CAPIO_SHM_NUMA_NODE");
+        if (val != nullptr && strcmp(val, "auto") == 0) {
+            node = CAPIO_SHM_NUMA_NODE_AUTO;
+        } else if (val != nullptr) {
+            auto [ptr, ec] = std::from_chars(val, val + strlen(val), node);
+            if (ec != std::errc() || node < 0 || node >= CAPIO_SHM_NUMA_MAX_NODES) {
+                node = CAPIO_SHM_NUMA_NODE_NONE;
+            }
+        }
+        initialized = true;
+    }
+    return node;
+}
+
 #endif // CAPIO_COMMON_ENV_HPP
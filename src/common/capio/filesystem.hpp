@@ -26,6 +26,18 @@ std::filesystem::path get_parent_dir_path(const std::filesystem::path &file_path
     return {file_path.native().substr(0, pos)};
 }
 
+// FNV-1a of @param path starting from @param seed, followed by the finalizer of splitmix64. Never 0
+inline unsigned long long capio_path_hash(const std::string &path, unsigned long long seed) {
+    unsigned long long hash = seed;
+    for (const unsigned char c : path) {
+        hash = (hash ^ c) * 0x100000001b3ULL;
+    }
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    hash = hash ^ (hash >> 31);
+    return hash == 0 ? 1 : hash;
+}
+
 inline bool in_dir(const std::string &path, const std::string &glob) {
     const size_t res = path.find('/', glob.length() - 1);
     return res != std::string::npos;
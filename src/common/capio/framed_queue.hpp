@@ -0,0 +1,440 @@
+#ifndef CAPIO_FRAMED_QUEUE_HPP
+#define CAPIO_FRAMED_QUEUE_HPP
+
+#include <atomic>
+#include <climits>
+#include <cstring>
+
+#include <sched.h>
+#include <unistd.h>
+
+#include "capio/env.hpp"
+#include "capio/logger.hpp"
+#include "capio/semaphore.hpp"
+#include "capio/shm.hpp"
+
+/**
+ * Header of the shared memory object backing a FramedQueue. It occupies the first page of the
+ * object and is followed by the data area, which is mapped twice in a row. Offsets in the data
+ * area grow monotonically and are taken modulo the capacity.
+ */
+struct FramedQueueHeader {
+    std::atomic<unsigned int> magic; // set by the creator once the header is initialized
+    unsigned int version;
+    long int capacity;
+    std::atomic<int> group_size; // channels sharing the doorbell of this one, 0 until published
+    alignas(CAPIO_SHM_CACHE_LINE_SIZE) std::atomic<long int> head; // first byte not yet consumed
+    alignas(CAPIO_SHM_CACHE_LINE_SIZE) std::atomic<long int> tail; // first byte not yet reserved
+    alignas(CAPIO_SHM_CACHE_LINE_SIZE) std::atomic<long int> committed; // records published
+    alignas(CAPIO_SHM_CACHE_LINE_SIZE) FutexWord num_records;
+    alignas(CAPIO_SHM_CACHE_LINE_SIZE) FutexWord free_space; // bumped when the consumer frees space
+};
+
+/**
+ * Prefix of every record in a FramedQueue. Right after the reservation, the producer stamps the
+ * record with its size and its tid, so that the consumer can skip it if the producer terminates
+ * before committing it. The producer stores the payload length last, so that a non-zero length
+ * marks the record as committed. Records are padded to 8 bytes.
+ */
+struct FramedRecord {
+    std::atomic<unsigned int> len;
+    unsigned int size;
+    std::atomic<pid_t> producer;
+    unsigned int reserved;
+};
+
+// Size in bytes taken by a record of @param size bytes
+constexpr long int framed_record_stride(long int size) {
+    return (static_cast<long int>(sizeof(FramedRecord)) + size + 7) & ~7L;
+}
+
+/**
+ * Records staged by a single producer, to be published on a FramedQueue with a single reservation
+ * and a single post. The staging area has the same layout as the data area of the queue.
+ */
+class FramedBatch {
+  private:
+    const long int _capacity;
+    char *_buf;
+    long int _size = 0;
+    int _count     = 0;
+
+  public:
+    explicit FramedBatch(long int capacity) : _capacity(capacity), _buf(new char[capacity]) {}
+
+    FramedBatch(const FramedBatch &)            = delete;
+    FramedBatch &operator=(const FramedBatch &) = delete;
+    ~FramedBatch() { delete[] _buf; }
+
+    /**
+     * Append a record of @param size bytes to the batch
+     * @param size
+     * @return a pointer to the payload of the record, or nullptr if the batch is full
+     */
+    inline char *append(long int size) {
+        const long int stride = framed_record_stride(size);
+        if (_size + stride > _capacity) {
+            return nullptr;
+        }
+        auto record = reinterpret_cast<FramedRecord *>(_buf + _size);
+        record->len.store(static_cast<unsigned int>(size), std::memory_order_relaxed);
+        _size += stride;
+        _count++;
+        return reinterpret_cast<char *>(record) + sizeof(FramedRecord);
+    }
+
+    inline void clear() {
+        _size  = 0;
+        _count = 0;
+    }
+
+    [[nodiscard]] inline const char *data() const { return _buf; }
+    [[nodiscard]] inline long int size() const { return _size; }
+    [[nodiscard]] inline int count() const { return _count; }
+};
+
+/**
+ * Multi-producer / single-consumer queue of variable-length records. Producers reserve exactly
+ * the bytes they need by advancing the tail with a CAS, so short messages are packed densely and
+ * long ones are not truncated. Records can wrap around the end of the data area: as the area is
+ * mapped twice in a row, every record is contiguous in memory.
+ */
+class FramedQueue {
+  private:
+    const long int _capacity; // size of the data area in bytes, a multiple of the page size
+    long int _header_size;
+    const std::string _shm_name;
+    bool _created;
+    FramedQueueHeader *_header;
+    char *_data;
+    bool require_cleanup;
+    FutexSemaphore _num_records;
+    FutexWord *_doorbell = nullptr; // shared with other channels, see share_doorbell()
+    long int _consumed   = 0;       // records released, on the consumer side
+
+    // Make @param count committed records visible to the consumer, waking it up if needed
+    inline void _publish(int count) {
+        _header->committed.fetch_add(count);
+        if (_doorbell == nullptr) {
+            _num_records.unlock(count);
+        } else if (_doorbell->waiters.load() > 0) {
+            _doorbell->value.fetch_add(1);
+            capio_futex(&_doorbell->value, FUTEX_WAKE, INT_MAX);
+        }
+    }
+
+    // Sleep until the consumer moves the head past @param head
+    inline void _wait_free_space(long int head) {
+        auto &word = _header->free_space;
+        int seq    = word.value.load();
+        word.waiters.fetch_add(1);
+        if (_header->head.load() == head) {
+            capio_futex_wait(&word.value, seq);
+        }
+        word.waiters.fetch_sub(1);
+    }
+
+    /**
+     * Reserve @param bytes contiguous bytes of the data area and return a pointer to them.
+     * If @param end is not null, it is set to the offset following the reservation
+     */
+    inline char *_reserve_bytes(long int bytes, long int *end = nullptr) {
+        START_LOG(capio_syscall(SYS_gettid), "call(bytes=%ld)", bytes);
+        if (bytes <= 0 || bytes > _capacity) {
+            ERR_EXIT("Reservation of %ld bytes does not fit channel %s", bytes, _shm_name.c_str());
+        }
+
+        long int tail = _header->tail.load(std::memory_order_relaxed);
+        while (true) {
+            long int head = _header->head.load();
+            if (tail + bytes - head > _capacity) {
+                LOG("Channel is full. Waiting for the consumer");
+                _wait_free_space(head);
+                tail = _header->tail.load(std::memory_order_relaxed);
+            } else if (_header->tail.compare_exchange_weak(tail, tail + bytes,
+                                                           std::memory_order_acq_rel)) {
+                break;
+            }
+        }
+        if (end != nullptr) {
+            *end = tail + bytes;
+        }
+        return _data + tail % _capacity;
+    }
+
+    // Stamp @param record of @param size bytes as reserved by the calling thread
+    static inline void _stamp_record(FramedRecord *record, long int size, pid_t producer) {
+        record->size = static_cast<unsigned int>(size);
+        record->producer.store(producer, std::memory_order_release);
+    }
+
+    // Whether the record at the head was reserved by a thread that terminated before committing it
+    static inline bool _is_abandoned(const FramedRecord *record) {
+        const pid_t producer = record->producer.load(std::memory_order_acquire);
+        // the producer cannot commit the record once it is known to have terminated
+        return producer != 0 && capio_thread_exited(producer) &&
+               record->len.load(std::memory_order_acquire) == 0;
+    }
+
+    // Return the payload of the record at the head and set @param size to its length
+    inline char *_acquire_record(long int *size) {
+        auto record = reinterpret_cast<FramedRecord *>(
+            _data + _header->head.load(std::memory_order_relaxed) % _capacity);
+        unsigned int len;
+        // a producer with a later reservation might have committed before this one
+        for (unsigned int spin = 1; (len = record->len.load(std::memory_order_acquire)) == 0;
+             ++spin) {
+            if (spin < CAPIO_SPIN_YIELD_PERIOD) {
+                continue;
+            }
+            sched_yield();
+            if (spin % CAPIO_SHM_STALE_CHECK_PERIOD == 0 && _is_abandoned(record)) {
+                START_LOG(capio_syscall(SYS_gettid), "call()");
+                LOG("Skipping record of terminated producer %d", record->producer.load());
+                _free_record(record->size);
+                record = reinterpret_cast<FramedRecord *>(
+                    _data + _header->head.load(std::memory_order_relaxed) % _capacity);
+                spin = 0;
+            }
+        }
+        *size = len;
+        return reinterpret_cast<char *>(record) + sizeof(FramedRecord);
+    }
+
+    // Give the space of the record of @param size bytes at the head back to the producers
+    inline void _free_record(long int size) {
+        long int head = _header->head.load(std::memory_order_relaxed);
+        auto record   = _data + head % _capacity;
+
+        // stale bytes could be mistaken for a committed record once the space is reused
+        const long int stride = framed_record_stride(size);
+        memset(record, 0, stride);
+        _header->head.store(head + stride);
+
+        _header->free_space.value.fetch_add(1);
+        if (_header->free_space.waiters.load() > 0) {
+            capio_futex(&_header->free_space.value, FUTEX_WAKE, INT_MAX);
+        }
+    }
+
+    // Give the space of the record at the head back to the producers
+    inline void _release_record() {
+        auto record = reinterpret_cast<FramedRecord *>(
+            _data + _header->head.load(std::memory_order_relaxed) % _capacity);
+        _free_record(record->len.load(std::memory_order_relaxed));
+        _consumed++;
+    }
+
+  public:
+    // Map the channel @param shm_name with a data area of @param capacity bytes
+    FramedQueue(const std::string &shm_name, const long int capacity,
+                const std::string &workflow_name = get_capio_workflow_name(), bool cleanup = true)
+        : _capacity(capio_shm_round_size(capacity)), _header_size(capio_shm_page_size()),
+          _shm_name(workflow_name + "_" + shm_name),
+          _header(static_cast<FramedQueueHeader *>(create_mirrored_shm_if_not_exist(
+              _shm_name, _header_size, _capacity, &_created))),
+          _data(reinterpret_cast<char *>(_header) + _header_size), require_cleanup(cleanup),
+          _num_records(&_header->num_records, 0, _created) {
+        START_LOG(capio_syscall(SYS_gettid), "call(shm_name=%s, capacity=%ld, cleanup=%s)",
+                  shm_name.c_str(), capacity, cleanup ? "yes" : "no");
+
+        if (_created) {
+            LOG("Initializing header of framed channel %s", _shm_name.c_str());
+            _header->version  = CAPIO_SHM_CHANNEL_VERSION;
+            _header->capacity = _capacity;
+            _header->group_size.store(0, std::memory_order_relaxed);
+            _header->head.store(0, std::memory_order_relaxed);
+            _header->tail.store(0, std::memory_order_relaxed);
+            _header->committed.store(0, std::memory_order_relaxed);
+            _header->free_space.value.store(0, std::memory_order_relaxed);
+            _header->free_space.waiters.store(0, std::memory_order_relaxed);
+            _header->magic.store(CAPIO_SHM_CHANNEL_MAGIC, std::memory_order_release);
+        } else {
+            LOG("Waiting for the creator to initialize framed channel %s", _shm_name.c_str());
+            while (_header->magic.load(std::memory_order_acquire) != CAPIO_SHM_CHANNEL_MAGIC) {
+                sched_yield();
+            }
+            if (_header->version != CAPIO_SHM_CHANNEL_VERSION || _header->capacity != _capacity) {
+                ERR_EXIT("Channel %s has an incompatible layout (version=%d)", _shm_name.c_str(),
+                         _header->version);
+            }
+        }
+    }
+
+    FramedQueue(const FramedQueue &)            = delete;
+    FramedQueue &operator=(const FramedQueue &) = delete;
+    ~FramedQueue() {
+        START_LOG(capio_syscall(SYS_gettid), "call(_shm_name=%s)", _shm_name.c_str());
+        munmap(_header, _header_size + 2 * _capacity);
+        if (require_cleanup) {
+            LOG("Performing cleanup of allocated resources");
+            SHM_DESTROY_CHECK(_shm_name.c_str());
+        }
+    }
+
+    inline auto get_name() { return this->_shm_name; }
+
+    // Futex word of this channel, to be used as the doorbell of a group of channels
+    inline FutexWord *doorbell() { return &_header->num_records; }
+
+    /**
+     * Let the consumer of this and other channels wait on a single @param doorbell (see
+     * doorbell()) instead of the records of each channel. Producers then write to the doorbell
+     * only while the consumer is parked on it, i.e. when its waiters are non-zero: the consumer
+     * must register as waiter, then check available() on every channel before sleeping
+     */
+    inline void share_doorbell(FutexWord *doorbell) { _doorbell = doorbell; }
+
+    /**
+     * Agree on the number of channels sharing the doorbell of this one. The creator of the
+     * channel publishes @param size, the other processes wait for it and adopt its value
+     * @param size
+     * @return the published number of channels
+     */
+    inline int group_size(int size) {
+        START_LOG(capio_syscall(SYS_gettid), "call(size=%d)", size);
+        if (_created) {
+            _header->group_size.store(size, std::memory_order_release);
+            return size;
+        }
+        int published;
+        while ((published = _header->group_size.load(std::memory_order_acquire)) == 0) {
+            sched_yield();
+        }
+        return published;
+    }
+
+    // Offset of the first byte not yet consumed
+    inline long int head() const { return _header->head.load(); }
+
+    /**
+     * Number of committed records not yet released, on the consumer side. The load is
+     * sequentially consistent, so that a consumer about to park on a shared doorbell either sees
+     * a record or is seen as waiter by its producer
+     */
+    inline long int available() const { return _header->committed.load() - _consumed; }
+
+    /**
+     * Reserve a record of @param size bytes and return a pointer to its payload. The record is
+     * not visible to the consumer until it is committed
+     * @param size
+     * @param end if not null, set to the offset following the record
+     * @return
+     */
+    inline char *reserve(long int size, long int *end = nullptr) {
+        START_LOG(capio_syscall(SYS_gettid), "call(size=%ld)", size);
+
+        auto record =
+            reinterpret_cast<FramedRecord *>(_reserve_bytes(framed_record_stride(size), end));
+        _stamp_record(record, size, capio_syscall(SYS_gettid));
+        return reinterpret_cast<char *>(record + 1);
+    }
+
+    /**
+     * Publish the record of @param size bytes whose payload is pointed by @param payload
+     * @param payload
+     * @param size
+     */
+    inline void commit(char *payload, long int size) {
+        START_LOG(capio_syscall(SYS_gettid), "call(payload=0x%08x, size=%ld)", payload, size);
+
+        auto record = reinterpret_cast<FramedRecord *>(payload - sizeof(FramedRecord));
+        record->len.store(static_cast<unsigned int>(size), std::memory_order_release);
+        _publish(1);
+    }
+
+    inline void write(const char *data, long int size) {
+        START_LOG(capio_syscall(SYS_gettid), "call(data=0x%08x, size=%ld)", data, size);
+
+        char *payload = reserve(size);
+        memcpy(payload, data, size);
+        commit(payload, size);
+    }
+
+    /**
+     * Publish all the records staged in @param batch with a single reservation, then clear it
+     * @param batch
+     * @return the offset following the last record of the batch, or 0 if the batch is empty
+     */
+    inline long int write(FramedBatch &batch) {
+        START_LOG(capio_syscall(SYS_gettid), "call(size=%ld, count=%d)", batch.size(),
+                  batch.count());
+
+        if (batch.count() == 0) {
+            return 0;
+        }
+        long int end;
+        char *dst       = _reserve_bytes(batch.size(), &end);
+        const pid_t tid = capio_syscall(SYS_gettid);
+        // every record is stamped before any is committed, so the consumer can skip them all
+        for (long int offset = 0; offset < batch.size();) {
+            auto src          = reinterpret_cast<const FramedRecord *>(batch.data() + offset);
+            const auto length = src->len.load(std::memory_order_relaxed);
+            _stamp_record(reinterpret_cast<FramedRecord *>(dst + offset), length, tid);
+            offset += framed_record_stride(length);
+        }
+        for (long int offset = 0; offset < batch.size();) {
+            auto src          = reinterpret_cast<const FramedRecord *>(batch.data() + offset);
+            auto record       = reinterpret_cast<FramedRecord *>(dst + offset);
+            const auto length = src->len.load(std::memory_order_relaxed);
+            memcpy(reinterpret_cast<char *>(record + 1), reinterpret_cast<const char *>(src + 1),
+                   length);
+            record->len.store(length, std::memory_order_release);
+            offset += framed_record_stride(length);
+        }
+        _publish(batch.count());
+        batch.clear();
+        return end;
+    }
+
+    /**
+     * Wait until at least a record is available, then acquire all the available records. Each
+     * of them must then be accessed with acquire() and given back with release(). Not to be used
+     * on channels sharing a doorbell, whose records are counted by available()
+     * @return the number of records acquired
+     */
+    inline int wait_records() {
+        START_LOG(capio_syscall(SYS_gettid), "call()");
+
+        return _num_records.lock_all();
+    }
+
+    /**
+     * Access in place the next record of the channel, waiting for its producer to commit it if
+     * needed. The consumer usually knows it exists from wait_records(). Producers do not reuse its
+     * space until release() is called, which must happen before the next record is accessed
+     * @param size set to the size of the record
+     * @return a pointer to the payload of the record
+     */
+    inline const char *acquire(long int *size) {
+        START_LOG(capio_syscall(SYS_gettid), "call()");
+
+        return _acquire_record(size);
+    }
+
+    // Release the record accessed with acquire()
+    inline void release() {
+        START_LOG(capio_syscall(SYS_gettid), "call()");
+
+        _release_record();
+    }
+
+    /**
+     * Copy the next record into @param buff_rcv, which must be large enough to hold it. Not to be
+     * used on channels sharing a doorbell.
+     * @param buff_rcv
+     * @return the size of the record
+     */
+    inline long int read(char *buff_rcv) {
+        START_LOG(capio_syscall(SYS_gettid), "call(buff_rcv=0x%08x)", buff_rcv);
+
+        long int size;
+        _num_records.lock();
+        const char *payload = _acquire_record(&size);
+        memcpy(buff_rcv, payload, size);
+        _release_record();
+        return size;
+    }
+};
+
+#endif // CAPIO_FRAMED_QUEUE_HPP
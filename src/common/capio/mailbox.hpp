@@ -0,0 +1,208 @@
+#ifndef CAPIO_MAILBOX_HPP
+#define CAPIO_MAILBOX_HPP
+
+#include <atomic>
+#include <ctime>
+
+#include <sched.h>
+
+#include "capio/constants.hpp"
+#include "capio/env.hpp"
+#include "capio/logger.hpp"
+#include "capio/semaphore.hpp"
+#include "capio/shm.hpp"
+
+/**
+ * Response channel of a single client thread. At most one reply is outstanding per thread, so a
+ * mailbox holds just the reply value and the futex word the client sleeps on.
+ */
+struct alignas(CAPIO_SHM_CACHE_LINE_SIZE) CapioMailbox {
+    std::atomic<capio_off64_t> value;
+    FutexWord ready;                     // number of replies not yet consumed by the owner
+    std::atomic<pid_t> owner;            // 0 when the mailbox is free
+    std::atomic<unsigned int> spin_hits; // replies received while spinning
+    std::atomic<unsigned int> parks;     // replies received after sleeping on the futex
+};
+
+static_assert(sizeof(CapioMailbox) == CAPIO_SHM_CACHE_LINE_SIZE,
+              "A mailbox must fit a single cache line");
+
+struct alignas(CAPIO_SHM_CACHE_LINE_SIZE) MailboxSlabHeader {
+    std::atomic<unsigned int> magic; // set by the creator once the slab is initialized
+    unsigned int version;
+    int nr_mailboxes;
+};
+
+/**
+ * Slab of CapioMailbox shared by the server and all the clients of a workflow, allocated in a
+ * single shared memory object. Clients claim a free mailbox for each thread and communicate its
+ * index to the server during the handshake.
+ */
+class MailboxSlab {
+  private:
+    const int _nr_mailboxes;
+    const std::string _shm_name;
+    bool _created;
+    MailboxSlabHeader *_header;
+    CapioMailbox *_mailboxes;
+    bool require_cleanup;
+
+    [[nodiscard]] inline long int _size() const {
+        return sizeof(MailboxSlabHeader) + _nr_mailboxes * sizeof(CapioMailbox);
+    }
+
+  public:
+    explicit MailboxSlab(const int nr_mailboxes,
+                         const std::string &workflow_name = get_capio_workflow_name(),
+                         bool cleanup                     = true)
+        : _nr_mailboxes(nr_mailboxes), _shm_name(workflow_name + "_" + SHM_COMM_CHAN_NAME_RESP),
+          _header(static_cast<MailboxSlabHeader *>(
+              create_shm_if_not_exist(_shm_name, _size(), &_created))),
+          _mailboxes(reinterpret_cast<CapioMailbox *>(_header + 1)), require_cleanup(cleanup) {
+        START_LOG(capio_syscall(SYS_gettid), "call(nr_mailboxes=%d, cleanup=%s)", nr_mailboxes,
+                  cleanup ? "yes" : "no");
+
+        if (_created) {
+            LOG("Initializing mailbox slab %s", _shm_name.c_str());
+            _header->version      = CAPIO_SHM_CHANNEL_VERSION;
+            _header->nr_mailboxes = _nr_mailboxes;
+            for (int i = 0; i < _nr_mailboxes; ++i) {
+                _mailboxes[i].owner.store(0, std::memory_order_relaxed);
+            }
+            _header->magic.store(CAPIO_SHM_CHANNEL_MAGIC, std::memory_order_release);
+        } else {
+            LOG("Waiting for the creator to initialize mailbox slab %s", _shm_name.c_str());
+            while (_header->magic.load(std::memory_order_acquire) != CAPIO_SHM_CHANNEL_MAGIC) {
+                sched_yield();
+            }
+            if (_header->version != CAPIO_SHM_CHANNEL_VERSION ||
+                _header->nr_mailboxes != _nr_mailboxes) {
+                ERR_EXIT("Mailbox slab %s has an incompatible layout (version=%d)",
+                         _shm_name.c_str(), _header->version);
+            }
+        }
+    }
+
+    MailboxSlab(const MailboxSlab &)            = delete;
+    MailboxSlab &operator=(const MailboxSlab &) = delete;
+    ~MailboxSlab() {
+        START_LOG(capio_syscall(SYS_gettid), "call(_shm_name=%s)", _shm_name.c_str());
+        munmap(_header, capio_shm_round_size(_size()));
+        if (require_cleanup) {
+            LOG("Performing cleanup of allocated resources");
+            SHM_DESTROY_CHECK(_shm_name.c_str());
+        }
+    }
+
+    /**
+     * Claim a free mailbox for thread @param tid. Mailboxes left behind by terminated threads are
+     * reclaimed when no free one is available
+     * @param tid
+     * @return the index of the mailbox
+     */
+    inline int claim(pid_t tid) {
+        START_LOG(capio_syscall(SYS_gettid), "call(tid=%d)", tid);
+
+        const int hint = tid % _nr_mailboxes;
+        for (int pass = 0; pass < 2; ++pass) {
+            for (int i = 0; i < _nr_mailboxes; ++i) {
+                const int index = (hint + i) % _nr_mailboxes;
+                auto &mailbox   = _mailboxes[index];
+                pid_t owner     = mailbox.owner.load(std::memory_order_relaxed);
+                // a mailbox owned by a thread with the same tid is a leftover of a dead thread
+                if ((owner == 0 || owner == tid || (pass == 1 && capio_thread_exited(owner))) &&
+                    mailbox.owner.compare_exchange_strong(owner, tid)) {
+                    LOG("Claimed mailbox %d", index);
+                    mailbox.value.store(0, std::memory_order_relaxed);
+                    mailbox.ready.value.store(0, std::memory_order_relaxed);
+                    mailbox.ready.waiters.store(0, std::memory_order_relaxed);
+                    mailbox.spin_hits.store(0, std::memory_order_relaxed);
+                    mailbox.parks.store(0, std::memory_order_relaxed);
+                    return index;
+                }
+            }
+        }
+        ERR_EXIT("No free mailbox available in %s", _shm_name.c_str());
+        return -1;
+    }
+
+    /**
+     * Release @param mailbox, if it is still owned by thread @param tid
+     * @param mailbox
+     * @param tid
+     */
+    static inline void release(CapioMailbox *mailbox, pid_t tid) {
+        START_LOG(capio_syscall(SYS_gettid), "call(mailbox=0x%08x, tid=%d)", mailbox, tid);
+        mailbox->owner.compare_exchange_strong(tid, 0);
+    }
+
+    /**
+     * Return mailbox @param index, checking that it is owned by thread @param tid
+     * @param index
+     * @param tid
+     * @return
+     */
+    inline CapioMailbox *at(int index, pid_t tid) {
+        START_LOG(capio_syscall(SYS_gettid), "call(index=%d, tid=%d)", index, tid);
+        if (index < 0 || index >= _nr_mailboxes || _mailboxes[index].owner.load() != tid) {
+            ERR_EXIT("Mailbox %d is not owned by thread %d", index, tid);
+        }
+        return _mailboxes + index;
+    }
+
+    /**
+     * Store @param value in @param mailbox and wake up its owner
+     * @param mailbox
+     * @param value
+     */
+    static inline void post(CapioMailbox *mailbox, capio_off64_t value) {
+        START_LOG(capio_syscall(SYS_gettid), "call(mailbox=0x%08x, value=%llu)", mailbox, value);
+        mailbox->value.store(value, std::memory_order_relaxed);
+        FutexSemaphore(&mailbox->ready, 0, false).unlock();
+    }
+
+    /**
+     * Wait for a reply on @param mailbox and return its value. The caller polls the mailbox for up
+     * to @param spin_ns nanoseconds, yielding the CPU now and then, before sleeping on the futex
+     * @param mailbox
+     * @param spin_ns
+     * @return
+     */
+    static inline capio_off64_t wait(CapioMailbox *mailbox, long int spin_ns = 0) {
+        START_LOG(capio_syscall(SYS_gettid), "call(mailbox=0x%08x, spin_ns=%ld)", mailbox, spin_ns);
+        FutexSemaphore ready(&mailbox->ready, 0, false);
+
+        if (spin_ns > 0) {
+            timespec start{}, now{};
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            for (unsigned int i = 1;; ++i) {
+                if (ready.try_lock()) {
+                    mailbox->spin_hits.fetch_add(1, std::memory_order_relaxed);
+                    return mailbox->value.load(std::memory_order_relaxed);
+                }
+                if (i % CAPIO_SPIN_YIELD_PERIOD != 0) {
+#if defined(__x86_64__) || defined(__i386__)
+                    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+                    asm volatile("yield");
+#endif
+                    continue;
+                }
+                // let the server run if it shares the CPU with the caller
+                sched_yield();
+                clock_gettime(CLOCK_MONOTONIC, &now);
+                if ((now.tv_sec - start.tv_sec) * 1000000000 + now.tv_nsec - start.tv_nsec >=
+                    spin_ns) {
+                    break;
+                }
+            }
+        }
+
+        LOG("No reply while spinning. Waiting on futex");
+        ready.lock();
+        mailbox->parks.fetch_add(1, std::memory_order_relaxed);
+        return mailbox->value.load(std::memory_order_relaxed);
+    }
+};
+
+#endif // CAPIO_MAILBOX_HPP
@@ -1,9 +1,11 @@
 #ifndef CAPIO_QUEUE_HPP
 #define CAPIO_QUEUE_HPP
 
+#include <atomic>
 #include <iostream>
 #include <mutex>
 
+#include <sched.h>
 #include <semaphore.h>
 
 #include "capio/env.hpp"
@@ -11,92 +13,185 @@
 #include "capio/semaphore.hpp"
 #include "capio/shm.hpp"
 
-template <class T, class Mutex> class Queue {
+/**
+ * Header of the single shared memory object backing a Queue. It is followed by the slot array
+ * and by the state of each slot. Indexes and wait words that are written by different sides of
+ * the channel live on separate cache lines.
+ */
+struct QueueHeader {
+    std::atomic<unsigned int> magic; // set by the creator once the header is initialized
+    unsigned int version;
+    long int max_num_elems, elem_size;
+    alignas(CAPIO_SHM_CACHE_LINE_SIZE) std::atomic<long int> first_elem;
+    alignas(CAPIO_SHM_CACHE_LINE_SIZE) std::atomic<long int> last_elem;
+    alignas(CAPIO_SHM_CACHE_LINE_SIZE) FutexWord mutex;
+    alignas(CAPIO_SHM_CACHE_LINE_SIZE) FutexWord sem_num_elems;
+    alignas(CAPIO_SHM_CACHE_LINE_SIZE) FutexWord sem_num_empty;
+};
+
+template <class T, class Mutex, class Semaphore> class Queue {
   private:
-    void *_shm;
+    static_assert(std::atomic<long int>::is_always_lock_free,
+                  "Shared memory indexes must be lock-free atomics");
+
     const long int _max_num_elems, _elem_size; // elements size in bytes
     long int _buff_size;                       // buffer size in bytes
-    long int *_first_elem = nullptr, *_last_elem = nullptr;
-    const std::string _shm_name, _first_elem_name, _last_elem_name;
+    long int _shm_size;                        // size of the whole shared memory object
+    const std::string _shm_name;
+    bool _created;
+    QueueHeader *_header;
+    void *_shm;                  // first slot
+    std::atomic<long int> *_seq; // per-slot states
     bool require_cleanup;
     Mutex _mutex;
-    NamedSemaphore _sem_num_elems, _sem_num_empty;
+    Semaphore _sem_num_elems, _sem_num_empty;
 
-    inline void _read(T *buff_recv, capio_off64_t num_bytes) {
-        _sem_num_elems.lock();
+    static inline void _wait_seq(const std::atomic<long int> &seq, long int expected) {
+        for (int spin = 0; seq.load(std::memory_order_acquire) != expected; ++spin) {
+            if (spin > 64) {
+                sched_yield();
+            }
+        }
+    }
 
-        std::lock_guard<Mutex> lg(_mutex);
-        memcpy(reinterpret_cast<char *>(buff_recv), reinterpret_cast<char *>(_shm) + *_first_elem,
-               num_bytes);
-        *_first_elem = (*_first_elem + _elem_size) % _buff_size;
+    /*
+     * Slots are assigned under the mutex but filled and consumed outside of it. _seq holds the
+     * state of each slot, so that a consumer never reads a slot that is still being filled, and a
+     * producer never overwrites a slot that is still in use.
+     */
+    static constexpr long int _slot_free = 0, _slot_ready = 1, _slot_busy = 2;
 
-        _sem_num_empty.unlock();
+    inline long int _slot_index(const T *segment) const {
+        return (reinterpret_cast<const char *>(segment) - reinterpret_cast<char *>(_shm)) /
+               _elem_size;
     }
 
-    inline void _write(const T *data, unsigned long long int num_bytes) {
+    inline T *_reserve_slot() {
         _sem_num_empty.lock();
 
-        std::lock_guard<Mutex> lg(_mutex);
-        memcpy(reinterpret_cast<char *>(_shm) + *_last_elem, reinterpret_cast<const char *>(data),
-               num_bytes);
-        *_last_elem = (*_last_elem + _elem_size) % _buff_size;
+        long int last_elem;
+        {
+            std::lock_guard<Mutex> lg(_mutex);
+            last_elem = _header->last_elem.load(std::memory_order_relaxed);
+            _header->last_elem.store((last_elem + _elem_size) % _buff_size,
+                                     std::memory_order_relaxed);
+        }
+        // a consumer might still be using the slot, if consumers release out of order
+        _wait_seq(_seq[last_elem / _elem_size], _slot_free);
+        return reinterpret_cast<char *>(_shm) + last_elem;
+    }
 
+    inline void _commit_slot(T *segment) {
+        _seq[_slot_index(segment)].store(_slot_ready, std::memory_order_release);
         _sem_num_elems.unlock();
     }
 
+    inline T *_fetch_slot() {
+        _sem_num_elems.lock();
+
+        long int first_elem;
+        {
+            std::lock_guard<Mutex> lg(_mutex);
+            first_elem = _header->first_elem.load(std::memory_order_relaxed);
+            _header->first_elem.store((first_elem + _elem_size) % _buff_size,
+                                      std::memory_order_relaxed);
+        }
+        // a producer with a later slot might have committed before this one
+        _wait_seq(_seq[first_elem / _elem_size], _slot_ready);
+        _seq[first_elem / _elem_size].store(_slot_busy, std::memory_order_relaxed);
+        return reinterpret_cast<char *>(_shm) + first_elem;
+    }
+
+    inline void _release_slot(T *segment) {
+        _seq[_slot_index(segment)].store(_slot_free, std::memory_order_release);
+        _sem_num_empty.unlock();
+    }
+
+    inline void _read(T *buff_recv, capio_off64_t num_bytes) {
+        T *segment = _fetch_slot();
+        memcpy(reinterpret_cast<char *>(buff_recv), reinterpret_cast<char *>(segment), num_bytes);
+        _release_slot(segment);
+    }
+
+    inline void _write(const T *data, unsigned long long int num_bytes) {
+        T *segment = _reserve_slot();
+        memcpy(reinterpret_cast<char *>(segment), reinterpret_cast<const char *>(data), num_bytes);
+        _commit_slot(segment);
+    }
+
   public:
     Queue(const std::string &shm_name, const long int max_num_elems, const long int elem_size,
           const std::string &workflow_name = get_capio_workflow_name(), bool cleanup = true)
         : _max_num_elems(max_num_elems), _elem_size(elem_size),
-          _buff_size(_max_num_elems * _elem_size), _shm_name(workflow_name + "_" + shm_name),
-          _first_elem_name(workflow_name + SHM_FIRST_ELEM + shm_name),
-          _last_elem_name(workflow_name + SHM_LAST_ELEM + shm_name),
-          _mutex(workflow_name + SHM_MUTEX_PREFIX + shm_name, 1),
-          _sem_num_elems(workflow_name + SHM_SEM_ELEMS + shm_name, 0),
-          _sem_num_empty(workflow_name + SHM_SEM_EMPTY + shm_name, max_num_elems),
-          require_cleanup(cleanup) {
+          _buff_size(_max_num_elems * _elem_size),
+          _shm_size(sizeof(QueueHeader) + _buff_size + _max_num_elems * sizeof(long int)),
+          _shm_name(workflow_name + "_" + shm_name),
+          _header(static_cast<QueueHeader *>(
+              create_shm_if_not_exist(_shm_name, _shm_size, &_created))),
+          require_cleanup(cleanup), _mutex(&_header->mutex, 1, _created),
+          _sem_num_elems(&_header->sem_num_elems, 0, _created),
+          _sem_num_empty(&_header->sem_num_empty, max_num_elems, _created) {
         START_LOG(capio_syscall(SYS_gettid),
                   "call(shm_name=%s, _max_num_elems=%ld, elem_size=%ld, "
                   "workflow_name=%s, cleanup=%s)",
                   shm_name.data(), max_num_elems, elem_size, workflow_name.data(),
                   cleanup ? "yes" : "no");
 
-        _first_elem = (long int *) create_shm(_first_elem_name, sizeof(long int));
-        _last_elem  = (long int *) create_shm(_last_elem_name, sizeof(long int));
-        _shm        = get_shm_if_exist(_shm_name);
-        if (_shm == nullptr) {
-            *_first_elem = 0;
-            *_last_elem  = 0;
-            _shm         = create_shm(_shm_name, _buff_size);
+        _shm = reinterpret_cast<char *>(_header) + sizeof(QueueHeader);
+        _seq = reinterpret_cast<std::atomic<long int> *>(reinterpret_cast<char *>(_shm) +
+                                                         _buff_size);
+
+        if (_created) {
+            LOG("Initializing header of channel %s", _shm_name.c_str());
+            _header->version       = CAPIO_SHM_CHANNEL_VERSION;
+            _header->max_num_elems = _max_num_elems;
+            _header->elem_size     = _elem_size;
+            _header->first_elem.store(0, std::memory_order_relaxed);
+            _header->last_elem.store(0, std::memory_order_relaxed);
+            for (long int i = 0; i < _max_num_elems; i++) {
+                _seq[i].store(_slot_free, std::memory_order_relaxed);
+            }
+            _header->magic.store(CAPIO_SHM_CHANNEL_MAGIC, std::memory_order_release);
+        } else {
+            LOG("Waiting for the creator to initialize channel %s", _shm_name.c_str());
+            while (_header->magic.load(std::memory_order_acquire) != CAPIO_SHM_CHANNEL_MAGIC) {
+                sched_yield();
+            }
+            if (_header->version != CAPIO_SHM_CHANNEL_VERSION ||
+                _header->max_num_elems != _max_num_elems || _header->elem_size != _elem_size) {
+                ERR_EXIT("Channel %s has an incompatible layout (version=%d)", _shm_name.c_str(),
+                         _header->version);
+            }
         }
     }
 
     Queue(const Queue &)            = delete;
     Queue &operator=(const Queue &) = delete;
     ~Queue() {
-        START_LOG(capio_syscall(SYS_gettid),
-                  "call(_shm_name=%s, _first_elem_name=%s, _last_elem_name=%s)", _shm_name.c_str(),
-                  _first_elem_name.c_str(), _last_elem_name.c_str());
+        START_LOG(capio_syscall(SYS_gettid), "call(_shm_name=%s)", _shm_name.c_str());
+        munmap(_header, capio_shm_round_size(_shm_size));
         if (require_cleanup) {
             LOG("Performing cleanup of allocated resources");
             SHM_DESTROY_CHECK(_shm_name.c_str());
-            SHM_DESTROY_CHECK(_first_elem_name.c_str());
-            SHM_DESTROY_CHECK(_last_elem_name.c_str());
         }
     }
 
+    /**
+     * Wait for the next element and return a pointer to it in place. The slot is not reused by
+     * producers until it is given back with release()
+     * @return
+     */
     inline T *fetch() {
         START_LOG(capio_syscall(SYS_gettid), "call()");
 
-        _sem_num_elems.lock();
-
-        std::lock_guard<Mutex> lg(_mutex);
-        T *segment   = reinterpret_cast<char *>(_shm) + *_first_elem;
-        *_first_elem = (*_first_elem + _elem_size) % _buff_size;
+        return _fetch_slot();
+    }
 
-        _sem_num_empty.unlock();
+    // Give back @param segment, obtained with fetch(), to the producers
+    inline void release(T *segment) {
+        START_LOG(capio_syscall(SYS_gettid), "call(segment=0x%08x)", segment);
 
-        return segment;
+        _release_slot(segment);
     }
 
     inline auto get_name() { return this->_shm_name; }
@@ -121,18 +216,22 @@ template <class T, class Mutex> class Queue {
         this->read(buf_rcv, _elem_size);
     }
 
+    /**
+     * Reserve a free slot and return a pointer to it, to build an element in place. The element
+     * is not visible to consumers until it is published with commit()
+     * @return
+     */
     inline T *reserve() {
         START_LOG(capio_syscall(SYS_gettid), "call()");
 
-        _sem_num_empty.lock();
-
-        std::lock_guard<Mutex> lg(_mutex);
-        T *segment  = reinterpret_cast<char *>(_shm) + *_last_elem;
-        *_last_elem = (*_last_elem + _elem_size) % _buff_size;
+        return _reserve_slot();
+    }
 
-        _sem_num_elems.unlock();
+    // Publish @param segment, obtained with reserve(), to the consumers
+    inline void commit(T *segment) {
+        START_LOG(capio_syscall(SYS_gettid), "call(segment=0x%08x)", segment);
 
-        return segment;
+        _commit_slot(segment);
     }
 
     inline void write(const T *data, unsigned long long int num_bytes) {
@@ -156,8 +255,8 @@ template <class T, class Mutex> class Queue {
 };
 
 // Circular Buffer queue for requests
-template <class T> using CircularBuffer = Queue<T, NamedSemaphore>;
+template <class T> using CircularBuffer = Queue<T, FutexSemaphore, FutexSemaphore>;
 
 // Single Producer Single Consumer queue
-using SPSCQueue = Queue<char, NoLock>;
+using SPSCQueue = Queue<char, NoLock, FutexSemaphore>;
 #endif // CAPIO_QUEUE_HPP
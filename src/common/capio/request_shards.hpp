@@ -0,0 +1,113 @@
+#ifndef CAPIO_REQUEST_SHARDS_HPP
+#define CAPIO_REQUEST_SHARDS_HPP
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "capio/constants.hpp"
+#include "capio/env.hpp"
+#include "capio/framed_queue.hpp"
+#include "capio/logger.hpp"
+#include "capio/requests.hpp"
+
+/**
+ * Request channels of a workflow, split in shards made of a blocking and a notification lane.
+ * Client threads running on different CPUs publish on different shards, so they do not contend
+ * on the tail of a single ring. The server parks on the doorbell of the blocking lane of shard 0,
+ * whose creator also chooses the number of shards. Producers ring it only while the server is
+ * parked, so that while it is busy they write only to the counters of their own shard.
+ */
+class RequestShards {
+  private:
+    std::vector<std::array<FramedQueue *, 2>> _shards;
+
+    // Shard 0 keeps the plain channel names
+    static inline std::string _lane_name(const char *name, int shard) {
+        return shard == 0 ? std::string(name) : std::string(name) + "_" + std::to_string(shard);
+    }
+
+  public:
+    /**
+     * Map the request channels, creating them if they do not exist yet
+     * @param nr_shards number of shards, used only if this process creates the channels.
+     * Otherwise the number chosen by their creator is adopted
+     * @param workflow_name
+     * @param cleanup
+     */
+    explicit RequestShards(int nr_shards,
+                           const std::string &workflow_name = get_capio_workflow_name(),
+                           bool cleanup                     = true) {
+        START_LOG(capio_syscall(SYS_gettid), "call(nr_shards=%d, cleanup=%s)", nr_shards,
+                  cleanup ? "yes" : "no");
+
+        auto leader = new FramedQueue(SHM_COMM_CHAN_NAME_BLOCKING, CAPIO_REQ_RING_SIZE,
+                                      workflow_name, cleanup);
+        nr_shards   = leader->group_size(nr_shards);
+        LOG("Using %d request shards", nr_shards);
+
+        _shards.resize(nr_shards);
+        for (int shard = 0; shard < nr_shards; ++shard) {
+            _shards[shard][CAPIO_REQUEST_LANE_BLOCKING] =
+                shard == 0 ? leader
+                           : new FramedQueue(_lane_name(SHM_COMM_CHAN_NAME_BLOCKING, shard),
+                                             CAPIO_REQ_RING_SIZE, workflow_name, cleanup);
+            _shards[shard][CAPIO_REQUEST_LANE_NOTIFICATION] = new FramedQueue(
+                _lane_name(SHM_COMM_CHAN_NAME, shard), CAPIO_REQ_RING_SIZE, workflow_name, cleanup);
+            for (auto channel : _shards[shard]) {
+                channel->share_doorbell(leader->doorbell());
+            }
+        }
+    }
+
+    RequestShards(const RequestShards &)            = delete;
+    RequestShards &operator=(const RequestShards &) = delete;
+    ~RequestShards() {
+        START_LOG(capio_syscall(SYS_gettid), "call()");
+        // the doorbell lives in the blocking lane of shard 0, which goes last
+        for (auto it = _shards.rbegin(); it != _shards.rend(); ++it) {
+            delete (*it)[CAPIO_REQUEST_LANE_NOTIFICATION];
+            delete (*it)[CAPIO_REQUEST_LANE_BLOCKING];
+        }
+    }
+
+    [[nodiscard]] inline int size() const { return static_cast<int>(_shards.size()); }
+
+    // Lane @param lane (one of CAPIO_REQUEST_LANE_*) of shard @param shard
+    inline FramedQueue *lane(int shard, int lane) const { return _shards[shard][lane]; }
+
+    // Whether a request is available on any lane
+    [[nodiscard]] inline bool pending() const {
+        for (const auto &shard : _shards) {
+            for (auto channel : shard) {
+                if (channel->available() > 0) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Park on the doorbell until a request is available on any lane. The caller must check every
+     * lane afterwards, as the wait may also end on a signal
+     */
+    inline void wait_requests() const {
+        START_LOG(capio_syscall(SYS_gettid), "call()");
+
+        auto doorbell = _shards[0][CAPIO_REQUEST_LANE_BLOCKING]->doorbell();
+        const int seq = doorbell->value.load();
+        // a producer committing after the check below sees the waiter and rings the doorbell
+        doorbell->waiters.fetch_add(1);
+        if (!pending()) {
+            LOG("No requests available. Waiting on the doorbell");
+            if (capio_futex_wait(&doorbell->value, seq) == -1 && errno != EAGAIN &&
+                errno != EINTR) {
+                ERR_EXIT("unable to wait on the request doorbell");
+            }
+        }
+        doorbell->waiters.fetch_sub(1);
+    }
+};
+
+#endif // CAPIO_REQUEST_SHARDS_HPP
@@ -1,6 +1,15 @@
 #ifndef CAPIO_COMMON_REQUESTS_HPP
 #define CAPIO_COMMON_REQUESTS_HPP
 
+#include <array>
+#include <cstring>
+#include <ctime>
+#include <string_view>
+
+#include <sys/types.h>
+
+#include "capio/constants.hpp"
+
 constexpr const int CAPIO_REQUEST_CONSENT             = 0;
 constexpr const int CAPIO_REQUEST_CLONE               = 1;
 constexpr const int CAPIO_REQUEST_CLOSE               = 2;
@@ -16,4 +25,210 @@ constexpr const int CAPIO_REQUEST_WRITE               = 11;
 
 constexpr const int CAPIO_NR_REQUESTS = 12;
 
+// Bumped every time the layout of a request changes
+constexpr const unsigned short CAPIO_REQUEST_PROTOCOL_VERSION = 4;
+
+/*
+ * Requests travel on two lanes. The blocking lane carries the requests whose caller waits for a
+ * reply, and is served first by the server. The notification lane carries everything else.
+ */
+constexpr const int CAPIO_REQUEST_LANE_BLOCKING     = 0;
+constexpr const int CAPIO_REQUEST_LANE_NOTIFICATION = 1;
+
+/*
+ * Binary encoding of requests.
+ * A request is one of the packed structs below, immediately followed by its string arguments in
+ * declaration order. Each string is stored as an unsigned short length followed by its bytes and
+ * a NUL terminator, so the server can use it in place as a C string.
+ */
+
+struct __attribute__((packed)) CapioRequestHeader {
+    unsigned short version;
+    unsigned short code;
+    pid_t tid;
+    long int fence;   // caller notifications on the same shard up to here are handled first
+    long int sent_at; // CLOCK_MONOTONIC nanoseconds at which the client issued the request
+};
+
+// strings: path, source_func
+struct __attribute__((packed)) ConsentRequest {
+    static constexpr int code       = CAPIO_REQUEST_CONSENT;
+    static constexpr int nr_strings = 2;
+    static constexpr int lane       = CAPIO_REQUEST_LANE_BLOCKING;
+    CapioRequestHeader header;
+};
+
+// strings: path
+struct __attribute__((packed)) CloseRequest {
+    static constexpr int code       = CAPIO_REQUEST_CLOSE;
+    static constexpr int nr_strings = 1;
+    static constexpr int lane       = CAPIO_REQUEST_LANE_NOTIFICATION;
+    CapioRequestHeader header;
+};
+
+// strings: path
+struct __attribute__((packed)) CreateRequest {
+    static constexpr int code       = CAPIO_REQUEST_CREATE;
+    static constexpr int nr_strings = 1;
+    static constexpr int lane       = CAPIO_REQUEST_LANE_NOTIFICATION;
+    CapioRequestHeader header;
+    int fd;
+};
+
+struct __attribute__((packed)) ExitGroupRequest {
+    static constexpr int code       = CAPIO_REQUEST_EXIT_GROUP;
+    static constexpr int nr_strings = 0;
+    static constexpr int lane       = CAPIO_REQUEST_LANE_NOTIFICATION;
+    CapioRequestHeader header;
+};
+
+// strings: app_name
+struct __attribute__((packed)) HandshakeNamedRequest {
+    static constexpr int code       = CAPIO_REQUEST_HANDSHAKE_NAMED;
+    static constexpr int nr_strings = 1;
+    static constexpr int lane       = CAPIO_REQUEST_LANE_BLOCKING;
+    CapioRequestHeader header;
+    pid_t pid;
+    int mailbox; // index of the response mailbox claimed by the thread
+};
+
+struct __attribute__((packed)) HandshakeAnonymousRequest {
+    static constexpr int code       = CAPIO_REQUEST_HANDSHAKE_ANONYMOUS;
+    static constexpr int nr_strings = 0;
+    static constexpr int lane       = CAPIO_REQUEST_LANE_BLOCKING;
+    CapioRequestHeader header;
+    pid_t pid;
+    int mailbox; // index of the response mailbox claimed by the thread
+};
+
+// strings: path
+struct __attribute__((packed)) OpenRequest {
+    static constexpr int code       = CAPIO_REQUEST_OPEN;
+    static constexpr int nr_strings = 1;
+    static constexpr int lane       = CAPIO_REQUEST_LANE_BLOCKING;
+    CapioRequestHeader header;
+    int fd;
+};
+
+// strings: path
+struct __attribute__((packed)) ReadRequest {
+    static constexpr int code       = CAPIO_REQUEST_READ;
+    static constexpr int nr_strings = 1;
+    static constexpr int lane       = CAPIO_REQUEST_LANE_BLOCKING;
+    CapioRequestHeader header;
+    int fd;
+    capio_off64_t end_of_read;
+};
+
+// strings: old_path, new_path
+struct __attribute__((packed)) RenameRequest {
+    static constexpr int code       = CAPIO_REQUEST_RENAME;
+    static constexpr int nr_strings = 2;
+    static constexpr int lane       = CAPIO_REQUEST_LANE_NOTIFICATION;
+    CapioRequestHeader header;
+};
+
+// strings: path
+struct __attribute__((packed)) WriteRequest {
+    static constexpr int code       = CAPIO_REQUEST_WRITE;
+    static constexpr int nr_strings = 1;
+    static constexpr int lane       = CAPIO_REQUEST_LANE_NOTIFICATION;
+    CapioRequestHeader header;
+    int fd;
+    capio_off64_t write_size;
+};
+
+template <class Req> using CapioRequestStrings = std::array<std::string_view, Req::nr_strings>;
+
+/**
+ * Typed view of a received request. Fixed fields are accessed in place through operator->, and
+ * str[i] points to the i-th string argument inside the request buffer
+ */
+template <class Req> struct CapioRequestView {
+    const Req *fixed;
+    std::array<const char *, Req::nr_strings> str;
+
+    const Req *operator->() const { return fixed; }
+};
+
+/**
+ * Compute the size in bytes of the encoding of a request of type Req with strings @param strs
+ * @tparam Req
+ * @param strs
+ * @return
+ */
+template <class Req>
+constexpr std::size_t capio_request_size(const CapioRequestStrings<Req> &strs) {
+    std::size_t size = sizeof(Req);
+    for (const auto &s : strs) {
+        size += sizeof(unsigned short) + s.size() + 1;
+    }
+    return size;
+}
+
+// Nanoseconds of CLOCK_MONOTONIC, which is shared by the server and its clients on a node
+inline long int capio_monotonic_ns() {
+    timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/**
+ * Encode @param req and @param strs into @param dst, which must hold at least
+ * capio_request_size<Req>(strs) bytes. Version, code and issue time of the header are filled in
+ * here.
+ * @tparam Req
+ * @param dst
+ * @param req
+ * @param strs
+ */
+template <class Req>
+inline void capio_encode_request(char *dst, Req req, const CapioRequestStrings<Req> &strs) {
+    req.header.version = CAPIO_REQUEST_PROTOCOL_VERSION;
+    req.header.code    = Req::code;
+    req.header.sent_at = capio_monotonic_ns();
+    memcpy(dst, &req, sizeof(Req));
+    dst += sizeof(Req);
+    for (const auto &s : strs) {
+        const auto len = static_cast<unsigned short>(s.size());
+        memcpy(dst, &len, sizeof(len));
+        dst += sizeof(len);
+        memcpy(dst, s.data(), len);
+        dst[len] = '\0';
+        dst += len + 1;
+    }
+}
+
+/**
+ * Build in @param view a typed view of the request of @param size bytes stored in @param src
+ * @tparam Req
+ * @param src
+ * @param size
+ * @param view
+ * @return false if the request is malformed
+ */
+template <class Req>
+inline bool capio_decode_request(const char *src, long int size, CapioRequestView<Req> *view) {
+    if (size < static_cast<long int>(sizeof(Req))) {
+        return false;
+    }
+    view->fixed     = reinterpret_cast<const Req *>(src);
+    const char *end = src + size;
+    src += sizeof(Req);
+    for (auto &s : view->str) {
+        unsigned short len;
+        if (end - src < static_cast<long int>(sizeof(len))) {
+            return false;
+        }
+        memcpy(&len, src, sizeof(len));
+        src += sizeof(len);
+        if (end - src < len + 1 || src[len] != '\0') {
+            return false;
+        }
+        s = src;
+        src += len + 1;
+    }
+    return true;
+}
+
 #endif // CAPIO_COMMON_REQUESTS_HPP
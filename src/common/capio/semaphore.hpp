@@ -1,17 +1,34 @@
 #ifndef CAPIO_SEMS_HPP
 #define CAPIO_SEMS_HPP
 
-#include <semaphore.h>
-
+#include <atomic>
 #include <utility>
 
+#include <linux/futex.h>
+#include <semaphore.h>
+
 #include "capio/logger.hpp"
 
+// Futex word shared between processes: the counter and the number of threads sleeping on it
+struct FutexWord {
+    std::atomic<int> value;
+    std::atomic<int> waiters;
+};
+
+// Issue a FUTEX_WAIT or FUTEX_WAKE on a futex word shared between processes
+inline long capio_futex(std::atomic<int> *addr, int op, int val) {
+    return capio_syscall(SYS_futex, reinterpret_cast<int *>(addr), op, val, nullptr, nullptr, 0);
+}
+
+// Sleep on @param addr as long as it holds @param val
+inline long capio_futex_wait(std::atomic<int> *addr, int val) {
+    return capio_futex(addr, FUTEX_WAIT, val);
+}
+
 class NoLock {
   public:
-    NoLock(const std::string &name, unsigned int init_value) {
-        START_LOG(capio_syscall(SYS_gettid), "call(name=%s, initial_value=%d)", name.c_str(),
-                  init_value);
+    NoLock(FutexWord *word, unsigned int init_value, bool initialize) {
+        START_LOG(capio_syscall(SYS_gettid), "call(initial_value=%d)", init_value);
     }
 
     NoLock(const NoLock &)            = delete;
@@ -23,49 +40,100 @@ class NoLock {
     static inline void unlock() { START_LOG(capio_syscall(SYS_gettid), "call()"); };
 };
 
-class NamedSemaphore {
+/**
+ * Counting semaphore backed by a futex word in shared memory. The futex syscalls are issued only
+ * when the semaphore is contended: lock() sleeps in FUTEX_WAIT only if the counter is zero, and
+ * unlock() calls FUTEX_WAKE only if some thread is registered as waiter. The word is owned by the
+ * caller, which usually places it in the header of a shared memory channel.
+ */
+class FutexSemaphore {
   private:
-    const std::string _name;
-    sem_t *_sem;
+    static_assert(std::atomic<int>::is_always_lock_free, "Futex words must be lock-free atomics");
+
+    FutexWord *_word;
 
   public:
-    NamedSemaphore(std::string name, unsigned int init_value) : _name(std::move(name)) {
-        START_LOG(capio_syscall(SYS_gettid), " call(name=%s, init_value=%d)", _name.c_str(),
-                  init_value);
+    FutexSemaphore(FutexWord *word, unsigned int init_value, bool initialize) : _word(word) {
+        START_LOG(capio_syscall(SYS_gettid), "call(word=0x%08x, init_value=%d, initialize=%s)",
+                  word, init_value, initialize ? "yes" : "no");
 
-        _sem = sem_open(_name.c_str(), O_CREAT | O_RDWR, S_IRUSR | S_IWUSR, init_value);
-        if (_sem == SEM_FAILED) {
-            ERR_EXIT(" sem_open %s failed", _name.c_str());
+        if (initialize) {
+            _word->value.store(static_cast<int>(init_value));
+            _word->waiters.store(0);
         }
     }
 
-    NamedSemaphore(const NamedSemaphore &)            = delete;
-    NamedSemaphore &operator=(const NamedSemaphore &) = delete;
-    ~NamedSemaphore() {
-        START_LOG(capio_syscall(SYS_gettid), "call()");
-        if (sem_destroy(_sem) != 0) {
-            ERR_EXIT(" destruction of semaphore %s failed", _name.c_str());
+    FutexSemaphore(const FutexSemaphore &)            = delete;
+    FutexSemaphore &operator=(const FutexSemaphore &) = delete;
+    ~FutexSemaphore()                                 = default;
+
+    inline void lock() {
+        START_LOG(capio_syscall(SYS_gettid), "call(word=0x%08x)", _word);
+
+        int value = _word->value.load(std::memory_order_relaxed);
+        while (value > 0) {
+            if (_word->value.compare_exchange_weak(value, value - 1, std::memory_order_acquire)) {
+                return;
+            }
         }
-        LOG(" Destroyed shared semaphore %s", _name.c_str());
-        if (sem_unlink(_name.c_str()) != 0) {
-            ERR_EXIT(" destruction of semaphore %s failed", _name.c_str());
+
+        LOG("Semaphore is contended. Waiting on futex");
+        _word->waiters.fetch_add(1);
+        while (true) {
+            value = _word->value.load();
+            if (value > 0) {
+                if (_word->value.compare_exchange_weak(value, value - 1)) {
+                    break;
+                }
+                continue;
+            }
+            if (capio_futex_wait(&_word->value, 0) == -1 && errno != EAGAIN && errno != EINTR) {
+                ERR_EXIT(" unable to acquire futex semaphore");
+            }
         }
-        LOG(" Unlinked shared semaphore %s", _name.c_str());
+        _word->waiters.fetch_sub(1);
     }
 
-    inline void lock() {
-        START_LOG(capio_syscall(SYS_gettid), "call(name=%s)", _name.c_str());
+    // Decrement the counter only if it is positive, without waiting
+    inline bool try_lock() {
+        int value = _word->value.load(std::memory_order_relaxed);
+        while (value > 0) {
+            if (_word->value.compare_exchange_weak(value, value - 1, std::memory_order_acquire)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Wait until the counter is positive, then decrement it to zero
+     * @return the amount subtracted from the counter
+     */
+    inline int lock_all() {
+        START_LOG(capio_syscall(SYS_gettid), "call(word=0x%08x)", _word);
 
-        if (sem_wait(_sem) == -1) {
-            ERR_EXIT(" unable to acquire %s", _name.c_str());
+        int value = _word->value.exchange(0, std::memory_order_acquire);
+        if (value > 0) {
+            return value;
         }
+
+        LOG("Semaphore is contended. Waiting on futex");
+        _word->waiters.fetch_add(1);
+        while ((value = _word->value.exchange(0)) == 0) {
+            if (capio_futex_wait(&_word->value, 0) == -1 && errno != EAGAIN && errno != EINTR) {
+                ERR_EXIT(" unable to acquire futex semaphore");
+            }
+        }
+        _word->waiters.fetch_sub(1);
+        return value;
     }
 
-    inline void unlock() {
-        START_LOG(capio_syscall(SYS_gettid), "call(name=%s)", _name.c_str());
+    inline void unlock(int n = 1) {
+        START_LOG(capio_syscall(SYS_gettid), "call(word=0x%08x, n=%d)", _word, n);
 
-        if (sem_post(_sem) == -1) {
-            ERR_EXIT(" unable to release %s", _name.c_str());
+        _word->value.fetch_add(n);
+        if (_word->waiters.load() > 0 && capio_futex(&_word->value, FUTEX_WAKE, n) == -1) {
+            ERR_EXIT(" unable to release futex semaphore");
         }
     }
 };
@@ -1,20 +1,26 @@
 #ifndef CAPIO_COMMON_SHM_HPP
 #define CAPIO_COMMON_SHM_HPP
 
+#include <cerrno>
 #include <string>
 #include <utility>
 
 #include <fcntl.h>
+#include <linux/magic.h>
+#include <linux/mempolicy.h>
+#include <signal.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/statfs.h>
 #include <unistd.h>
 
+#include "capio/env.hpp"
 #include "capio/logger.hpp"
 
 #ifdef __CAPIO_POSIX
 
 #define SHM_DESTROY_CHECK(source_name)                                                             \
-    if (shm_unlink(source_name) == -1) {                                                           \
+    if (capio_shm_unlink(source_name) == -1) {                                                     \
         ERR_EXIT("Unable to destroy shared mem:  ", source_name);                                  \
     };
 
@@ -26,7 +32,7 @@
 #else
 
 #define SHM_DESTROY_CHECK(source_name)                                                             \
-    if (shm_unlink(source_name) == -1) {                                                           \
+    if (capio_shm_unlink(source_name) == -1) {                                                     \
         std::cout << CAPIO_LOG_SERVER_CLI_LEVEL_WARNING << " [ " << node_name << " ] "             \
                   << "Unable to destroy shared mem: '" << source_name << "' (" << strerror(errno)  \
                   << ")" << std::endl;                                                             \
@@ -42,6 +48,104 @@
 
 #endif
 
+/*
+ * Allocation policy of the shared memory objects of CAPIO.
+ * When CAPIO_SHM_HUGETLBFS points to a hugetlbfs mount, objects are created there instead of
+ * through shm_open, so they are backed by huge pages while still being reachable by name from
+ * every process of the workflow. Sizes are then rounded up to the huge page size.
+ * When CAPIO_SHM_NUMA_NODE is set, the server binds the objects it maps to that NUMA node.
+ */
+
+/**
+ * Size of the pages backing CAPIO shared memory objects
+ * @return the huge page size of the hugetlbfs mount in use, or the base page size
+ */
+inline long int capio_shm_page_size() {
+    static long int page_size = 0;
+    if (page_size == 0) {
+        START_LOG(capio_syscall(SYS_gettid), "call()");
+        const auto &dir = get_capio_shm_hugetlbfs_dir();
+        struct statfs sfs {};
+        if (dir.empty()) {
+            page_size = sysconf(_SC_PAGESIZE);
+        } else if (statfs(dir.c_str(), &sfs) == -1 || sfs.f_type != HUGETLBFS_MAGIC) {
+            ERR_EXIT("CAPIO_SHM_HUGETLBFS=%s is not a hugetlbfs mount", dir.c_str());
+        } else {
+            page_size = sfs.f_bsize;
+        }
+    }
+    return page_size;
+}
+
+// Round @param size up to a multiple of capio_shm_page_size()
+inline long int capio_shm_round_size(long int size) {
+    const long int page_size = capio_shm_page_size();
+    return (size + page_size - 1) / page_size * page_size;
+}
+
+// Same as shm_open, following the allocation policy
+inline int capio_shm_open(const std::string &shm_name, int oflag, mode_t mode) {
+    const auto &dir = get_capio_shm_hugetlbfs_dir();
+    if (dir.empty()) {
+        return shm_open(shm_name.c_str(), oflag, mode);
+    }
+    return open((dir + "/" + shm_name).c_str(), oflag | O_CLOEXEC, mode);
+}
+
+// Same as shm_unlink, following the allocation policy
+inline int capio_shm_unlink(const std::string &shm_name) {
+    const auto &dir = get_capio_shm_hugetlbfs_dir();
+    if (dir.empty()) {
+        return shm_unlink(shm_name.c_str());
+    }
+    return unlink((dir + "/" + shm_name).c_str());
+}
+
+// Whether the thread @param tid, which used a shared memory object, terminated
+inline bool capio_thread_exited(pid_t tid) {
+    const long res = capio_syscall(SYS_kill, tid, 0);
+    return res == -ESRCH || (res == -1 && errno == ESRCH);
+}
+
+/**
+ * Bind the @param size bytes of @param shm_name mapped at @param addr to the NUMA node given by
+ * CAPIO_SHM_NUMA_NODE, migrating the pages already touched by other processes, and prefault them.
+ * Placement is decided by the server only: clients map objects as they find them
+ */
+inline void capio_shm_bind(void *addr, long int size, const std::string &shm_name) {
+#ifndef __CAPIO_POSIX
+    int node = get_capio_shm_numa_node();
+    if (node == CAPIO_SHM_NUMA_NODE_NONE) {
+        return;
+    }
+    START_LOG(capio_syscall(SYS_gettid), "call(shm_name=%s, size=%ld, node=%d)", shm_name.c_str(),
+              size, node);
+
+    if (node == CAPIO_SHM_NUMA_NODE_AUTO) {
+        unsigned int cpu, current_node;
+        if (syscall(SYS_getcpu, &cpu, &current_node, nullptr) == -1) {
+            LOG("Unable to get the NUMA node of the current thread");
+            return;
+        }
+        node = static_cast<int>(current_node);
+    }
+    constexpr int bits_per_word = 8 * sizeof(unsigned long);
+    unsigned long nodemask[CAPIO_SHM_NUMA_MAX_NODES / bits_per_word] = {};
+    nodemask[node / bits_per_word] |= 1UL << (node % bits_per_word);
+
+    // the kernel ignores the last bit of the mask, hence the + 1
+    if (syscall(SYS_mbind, addr, size, MPOL_PREFERRED, nodemask, CAPIO_SHM_NUMA_MAX_NODES + 1,
+                MPOL_MF_MOVE) == -1 ||
+        madvise(addr, size, MADV_POPULATE_WRITE) == -1) {
+        std::cout << CAPIO_LOG_SERVER_CLI_LEVEL_WARNING << " [ " << node_name << " ] "
+                  << "Unable to bind shared mem '" << shm_name << "' to NUMA node " << node << " ("
+                  << strerror(errno) << ")" << std::endl;
+        return;
+    }
+    LOG("Bound %s to NUMA node %d", shm_name.c_str(), node);
+#endif
+}
+
 class CapioShmCanary {
     int _shm_id;
     std::string _canary_name;
@@ -52,7 +156,7 @@ class CapioShmCanary {
         if (_canary_name.empty()) {
             _canary_name = get_capio_workflow_name();
         }
-        _shm_id = shm_open(_canary_name.data(), O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+        _shm_id = capio_shm_open(_canary_name, O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
         if (_shm_id == -1) {
             LOG(CAPIO_SHM_CANARY_ERROR, _canary_name.data());
 #ifndef __CAPIO_POSIX
@@ -100,6 +204,91 @@ void *create_shm(const std::string &shm_name, const long int size) {
     return p;
 }
 
+/**
+ * Open the shared memory object @param shm_name, creating it with @param size bytes if it does
+ * not exist yet. @param created is set to true only for the process that created the object,
+ * which is in charge of initializing it.
+ * @return the file descriptor of the object, to be closed by the caller
+ */
+int open_shm_if_not_exist(const std::string &shm_name, const long int size, bool *created) {
+    START_LOG(capio_syscall(SYS_gettid), "call(shm_name=%s, size=%ld)", shm_name.c_str(), size);
+
+    int fd   = capio_shm_open(shm_name, O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+    *created = fd != -1;
+    if (*created) {
+        if (ftruncate(fd, size) == -1) {
+            ERR_EXIT("ftruncate open_shm_if_not_exist %s", shm_name.c_str());
+        }
+    } else {
+        SHM_CREATE_CHECK(errno != EEXIST, shm_name.c_str());
+        fd = capio_shm_open(shm_name, O_RDWR, 0);
+        SHM_CREATE_CHECK(fd == -1, shm_name.c_str());
+        // wait for the creator to set the size of the object before mapping it
+        struct stat sb {};
+        do {
+            if (fstat(fd, &sb) == -1) {
+                ERR_EXIT("fstat %s", shm_name.c_str());
+            }
+        } while (sb.st_size < size);
+    }
+    return fd;
+}
+
+/**
+ * Map the shared memory object @param shm_name, creating it with @param size bytes if it does not
+ * exist yet. @param created is set as in open_shm_if_not_exist. The object and the mapping span
+ * capio_shm_round_size(size) bytes
+ */
+void *create_shm_if_not_exist(const std::string &shm_name, const long int size, bool *created) {
+    START_LOG(capio_syscall(SYS_gettid), "call(shm_name=%s, size=%ld)", shm_name.c_str(), size);
+
+    const long int shm_size = capio_shm_round_size(size);
+    int fd                  = open_shm_if_not_exist(shm_name, shm_size, created);
+    void *p                 = mmap(nullptr, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        ERR_EXIT("mmap create_shm_if_not_exist %s", shm_name.c_str());
+    }
+    if (close(fd) == -1) {
+        ERR_EXIT("close");
+    }
+    capio_shm_bind(p, shm_size, shm_name);
+    return p;
+}
+
+/**
+ * Map the shared memory object @param shm_name as a header of @param header_size bytes followed
+ * by a data area of @param size bytes. The data area is mapped twice in a row, so that a record
+ * wrapping around its end is still contiguous in the address space. Both sizes must be multiples
+ * of capio_shm_page_size(). The object is created as in create_shm_if_not_exist, and the mapping
+ * spans header_size + 2 * size bytes.
+ */
+void *create_mirrored_shm_if_not_exist(const std::string &shm_name, const long int header_size,
+                                       const long int size, bool *created) {
+    START_LOG(capio_syscall(SYS_gettid), "call(shm_name=%s, header_size=%ld, size=%ld)",
+              shm_name.c_str(), header_size, size);
+
+    int fd = open_shm_if_not_exist(shm_name, header_size + size, created);
+
+    // reserve the address range first, then replace it with the two views of the object
+    auto base = static_cast<char *>(
+        mmap(nullptr, header_size + 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (base == MAP_FAILED) {
+        ERR_EXIT("mmap reserve create_mirrored_shm_if_not_exist %s", shm_name.c_str());
+    }
+    if (mmap(base, header_size + size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) ==
+            MAP_FAILED ||
+        mmap(base + header_size + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd,
+             header_size) == MAP_FAILED) {
+        ERR_EXIT("mmap create_mirrored_shm_if_not_exist %s", shm_name.c_str());
+    }
+    if (close(fd) == -1) {
+        ERR_EXIT("close");
+    }
+    // the second view shares the pages of the first one
+    capio_shm_bind(base, header_size + size, shm_name);
+    return base;
+}
+
 void *get_shm(const std::string &shm_name) {
     START_LOG(capio_syscall(SYS_gettid), "call(shm_name=%s)", shm_name.c_str());
 
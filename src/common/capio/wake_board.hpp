@@ -0,0 +1,257 @@
+#ifndef CAPIO_WAKE_BOARD_HPP
+#define CAPIO_WAKE_BOARD_HPP
+
+#include <atomic>
+#include <climits>
+#include <mutex>
+
+#include "capio/constants.hpp"
+#include "capio/env.hpp"
+#include "capio/filesystem.hpp"
+#include "capio/logger.hpp"
+#include "capio/mailbox.hpp"
+#include "capio/semaphore.hpp"
+#include "capio/shm.hpp"
+
+// Events clients wait for on a file
+enum CapioWakeEvent : unsigned long long {
+    CAPIO_WAKE_CREATION = 0x6a09e667f3bcc908ULL,
+    CAPIO_WAKE_DATA     = 0xbb67ae8584caa73bULL,
+};
+
+/**
+ * Slot of the board assigned to the threads waiting for an event on a file. The server announces
+ * the event by storing its value and counting one more announcement, then wakes up all the
+ * threads sleeping on the generation word at once. The slot can be given to another file once
+ * no thread holds a ticket for it anymore
+ */
+struct alignas(CAPIO_SHM_CACHE_LINE_SIZE) CapioWakeSlot {
+    std::atomic<unsigned long long> key;   // first hash of the path and event, 0 if never claimed
+    std::atomic<unsigned long long> check; // second hash of the path and event
+    std::atomic<capio_off64_t> value;      // value of the last announcement
+    std::atomic<unsigned int> announced;   // number of announcements
+    std::atomic<unsigned int> holders;     // threads given a ticket that did not leave yet
+    FutexWord generation;                  // bumped at each announcement or kick
+};
+
+static_assert(sizeof(CapioWakeSlot) == CAPIO_SHM_CACHE_LINE_SIZE,
+              "A wake slot must fit a single cache line");
+
+struct alignas(CAPIO_SHM_CACHE_LINE_SIZE) WakeBoardHeader {
+    std::atomic<unsigned int> magic; // set by the creator once the board is initialized
+    unsigned int version;
+    int nr_slots;
+};
+
+/**
+ * Board shared by the server and all the clients of a workflow, on which the threads waiting for
+ * the same event on the same file sleep together, so that the server wakes them up with a single
+ * FUTEX_WAKE instead of replying to each of them. A waiting thread receives on its mailbox a
+ * ticket, holding its slot and the number of announcements seen when it was registered, and
+ * sleeps on the slot until a later announcement satisfies it. Slots are claimed and looked up by
+ * the server only, within CAPIO_WAKE_BOARD_PROBES slots of the hash of the file, and a slot is
+ * reused for another file as soon as the last thread holding a ticket for it leaves. Files are
+ * identified by two independent 64 bit hashes, as in the commit store
+ */
+class WakeBoard {
+  private:
+    static constexpr capio_off64_t _TICKET          = 1ULL << 63;
+    static constexpr unsigned long long _CHECK_SEED = 0x9e3779b97f4a7c15ULL;
+
+    const int _nr_slots;
+    const std::string _shm_name;
+    bool _created;
+    WakeBoardHeader *_header;
+    CapioWakeSlot *_slots;
+    bool require_cleanup;
+    std::mutex _mutex; // serializes the claims of slots by the threads of the server
+
+    [[nodiscard]] inline long int _size() const {
+        return sizeof(WakeBoardHeader) + _nr_slots * sizeof(CapioWakeSlot);
+    }
+
+    inline void _wake(CapioWakeSlot &slot) {
+        START_LOG(capio_syscall(SYS_gettid), "call(slot=%ld)", &slot - _slots);
+        slot.generation.value.fetch_add(1);
+        if (slot.generation.waiters.load() > 0 &&
+            capio_futex(&slot.generation.value, FUTEX_WAKE, INT_MAX) == -1) {
+            ERR_EXIT("Unable to wake up threads waiting on wake board");
+        }
+    }
+
+    // Count a thread leaving @param slot, which can be given to another file once none is left
+    static inline void _leave(CapioWakeSlot &slot) {
+        slot.holders.fetch_sub(1, std::memory_order_release);
+    }
+
+    /**
+     * Return the slot of @param event on @param path. Must be called with _mutex held
+     * @param path
+     * @param event
+     * @param create whether to claim a slot if there is none
+     * @return the index of the slot, or -1 if there is none
+     */
+    inline int _find(const std::string &path, CapioWakeEvent event, bool create) {
+        START_LOG(capio_syscall(SYS_gettid), "call(path=%s, create=%s)", path.c_str(),
+                  create ? "yes" : "no");
+        const unsigned long long key   = capio_path_hash(path, event);
+        const unsigned long long check = capio_path_hash(path, event ^ _CHECK_SEED);
+        int free                       = -1;
+        for (int i = 0; i < CAPIO_WAKE_BOARD_PROBES; ++i) {
+            const int index              = static_cast<int>((key + i) % _nr_slots);
+            auto &slot                   = _slots[index];
+            const unsigned long long cur = slot.key.load(std::memory_order_relaxed);
+            if (cur == key && slot.check.load(std::memory_order_relaxed) == check) {
+                return index;
+            }
+            if (free == -1 && (cur == 0 || slot.holders.load(std::memory_order_acquire) == 0)) {
+                free = index;
+            }
+            if (cur == 0) {
+                break; // slots are never emptied, so the file cannot be further
+            }
+        }
+        if (!create || free == -1) {
+            LOG("No slot found");
+            return -1;
+        }
+        // no thread holds a ticket for the slot, and only the server hands them out
+        LOG("Claimed slot %d", free);
+        _slots[free].check.store(check, std::memory_order_relaxed);
+        _slots[free].key.store(key, std::memory_order_relaxed);
+        return free;
+    }
+
+  public:
+    explicit WakeBoard(const int nr_slots,
+                       const std::string &workflow_name = get_capio_workflow_name(),
+                       bool cleanup                     = true)
+        : _nr_slots(nr_slots), _shm_name(workflow_name + "_" + SHM_WAKE_BOARD_NAME),
+          _header(static_cast<WakeBoardHeader *>(
+              create_shm_if_not_exist(_shm_name, _size(), &_created))),
+          _slots(reinterpret_cast<CapioWakeSlot *>(_header + 1)), require_cleanup(cleanup) {
+        START_LOG(capio_syscall(SYS_gettid), "call(nr_slots=%d, cleanup=%s)", nr_slots,
+                  cleanup ? "yes" : "no");
+
+        if (_created) {
+            LOG("Initializing wake board %s", _shm_name.c_str());
+            _header->version  = CAPIO_SHM_CHANNEL_VERSION;
+            _header->nr_slots = _nr_slots;
+            _header->magic.store(CAPIO_SHM_CHANNEL_MAGIC, std::memory_order_release);
+        } else {
+            LOG("Waiting for the creator to initialize wake board %s", _shm_name.c_str());
+            while (_header->magic.load(std::memory_order_acquire) != CAPIO_SHM_CHANNEL_MAGIC) {
+                sched_yield();
+            }
+            if (_header->version != CAPIO_SHM_CHANNEL_VERSION || _header->nr_slots != _nr_slots) {
+                ERR_EXIT("Wake board %s has an incompatible layout (version=%d)",
+                         _shm_name.c_str(), _header->version);
+            }
+        }
+    }
+
+    WakeBoard(const WakeBoard &)            = delete;
+    WakeBoard &operator=(const WakeBoard &) = delete;
+    ~WakeBoard() {
+        START_LOG(capio_syscall(SYS_gettid), "call(_shm_name=%s)", _shm_name.c_str());
+        munmap(_header, capio_shm_round_size(_size()));
+        if (require_cleanup) {
+            LOG("Performing cleanup of allocated resources");
+            SHM_DESTROY_CHECK(_shm_name.c_str());
+        }
+    }
+
+    /**
+     * Hand a ticket to a thread that starts waiting for @param event on @param path. The thread
+     * holds the slot until it leaves wait()
+     * @param path
+     * @param event
+     * @param claim whether to claim a slot if the file has none
+     * @return the ticket, or 0 if the file has no slot
+     */
+    inline capio_off64_t ticket(const std::string &path, CapioWakeEvent event, bool claim) {
+        std::lock_guard<std::mutex> lg(_mutex);
+        const int index = _find(path, event, claim);
+        if (index == -1) {
+            return 0;
+        }
+        auto &slot = _slots[index];
+        slot.holders.fetch_add(1, std::memory_order_relaxed);
+        return _TICKET | static_cast<capio_off64_t>(index) << 32 |
+               slot.announced.load(std::memory_order_acquire);
+    }
+
+    // Slot of the threads waiting for @param event on @param path, or -1 if the file has none
+    inline int find(const std::string &path, CapioWakeEvent event) {
+        std::lock_guard<std::mutex> lg(_mutex);
+        return _find(path, event, false);
+    }
+
+    // Whether the reply @param value of the server is a ticket
+    static inline bool is_ticket(capio_off64_t value) {
+        return value != ULLONG_MAX && (value & _TICKET) != 0;
+    }
+
+    /**
+     * Announce @param value to all the threads waiting on slot @param index
+     * @param index
+     * @param value
+     */
+    inline void announce(int index, capio_off64_t value) {
+        START_LOG(capio_syscall(SYS_gettid), "call(index=%d, value=%llu)", index, value);
+        auto &slot = _slots[index];
+        slot.value.store(value, std::memory_order_relaxed);
+        slot.announced.fetch_add(1, std::memory_order_release);
+        _wake(slot);
+    }
+
+    // Wake up the threads waiting on slot @param index to let them check their mailbox
+    inline void kick(int index) {
+        START_LOG(capio_syscall(SYS_gettid), "call(index=%d)", index);
+        _wake(_slots[index]);
+    }
+
+    /**
+     * Wait on the slot of @param ticket for an announcement made after the ticket of a value of at
+     * least @param need, or for a reply on @param mailbox, and then leave the slot
+     * @param ticket
+     * @param need
+     * @param mailbox
+     * @return the value announced, or the reply
+     */
+    inline capio_off64_t wait(capio_off64_t ticket, capio_off64_t need, CapioMailbox *mailbox) {
+        START_LOG(capio_syscall(SYS_gettid), "call(ticket=%llx, need=%llu)", ticket, need);
+        const int index         = static_cast<int>((ticket & ~_TICKET) >> 32);
+        const unsigned int seen = static_cast<unsigned int>(ticket);
+        if (index >= _nr_slots) {
+            ERR_EXIT("Invalid wake board ticket %llx", ticket);
+        }
+        auto &slot = _slots[index];
+        FutexSemaphore reply(&mailbox->ready, 0, false);
+
+        while (true) {
+            const int generation = slot.generation.value.load();
+            if (reply.try_lock()) {
+                LOG("Reply received while waiting on wake board");
+                _leave(slot);
+                return mailbox->value.load(std::memory_order_relaxed);
+            }
+            if (slot.announced.load(std::memory_order_acquire) != seen) {
+                const capio_off64_t value = slot.value.load(std::memory_order_relaxed);
+                if (value >= need) {
+                    LOG("Announced value %llu", value);
+                    _leave(slot);
+                    return value;
+                }
+            }
+            slot.generation.waiters.fetch_add(1);
+            if (capio_futex_wait(&slot.generation.value, generation) == -1 && errno != EAGAIN &&
+                errno != EINTR) {
+                ERR_EXIT("Unable to wait on wake board");
+            }
+            slot.generation.waiters.fetch_sub(1);
+        }
+    }
+};
+
+#endif // CAPIO_WAKE_BOARD_HPP
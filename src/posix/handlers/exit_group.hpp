@@ -18,6 +18,10 @@ int exit_handler(long arg0, long arg1, long arg2, long arg3, long arg4, long arg
     auto tid = static_cast<pid_t>(syscall_no_intercept(SYS_gettid));
     START_LOG(tid, "call()");
 
+    // the pending writes must be staged before the exit request
+    delete write_request_cache;
+    delete read_request_cache;
+
     if (is_capio_tid(tid)) {
         LOG("Thread %d is a CAPIO thread: clean up", tid);
 
@@ -25,8 +29,9 @@ int exit_handler(long arg0, long arg1, long arg2, long arg3, long arg4, long arg
         remove_capio_tid(tid);
     }
 
-    delete write_request_cache;
-    delete read_request_cache;
+    flush_requests();
+    delete staged_requests;
+    staged_requests = nullptr;
 
     return CAPIO_POSIX_SYSCALL_SKIP;
 }
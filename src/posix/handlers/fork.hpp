@@ -7,6 +7,9 @@
 #include "utils/requests.hpp"
 
 int fork_handler(long arg0, long arg1, long arg2, long arg3, long arg4, long arg5, long *result) {
+    // otherwise the child would inherit and publish again the staged requests
+    flush_requests();
+
     long parent_tid = syscall_no_intercept(SYS_gettid);
     auto pid        = static_cast<pid_t>(syscall_no_intercept(SYS_fork));
 
@@ -11,7 +11,7 @@ inline off64_t capio_write(int fd, capio_off64_t count, pid_t tid) {
 
     if (exists_capio_fd(fd)) {
         LOG("File needs to be handled");
-        write_request_cache->write_request(get_capio_fd_path(fd), count, tid, fd);
+        write_request_cache->write_request(get_capio_fd_path(fd), tid, fd, count);
     }
     return CAPIO_POSIX_SYSCALL_REQUEST_SKIP;
 }
@@ -347,6 +347,8 @@ static int hook(long syscall_number, long arg0, long arg1, long arg2, long arg3,
 
     START_LOG(syscall_no_intercept(SYS_gettid), "call(syscall_number=%ld)", syscall_number);
 
+    flush_requests_before(syscall_number);
+
     // If the syscall_number is higher than the maximum
     // syscall captured by CAPIO, simply return
     if (syscall_number >= CAPIO_NR_SYSCALLS) {
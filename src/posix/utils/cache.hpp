@@ -14,10 +14,11 @@ class WriteRequestCache {
     inline void _write_request(const off64_t count, const long tid, const long fd) {
         START_LOG(capio_syscall(SYS_gettid), "call(path=%s, count=%ld, tid=%ld)",
                   current_path.c_str(), count, tid);
-        char req[CAPIO_REQ_MAX_SIZE];
-        sprintf(req, "%04d %ld %ld %s %ld", CAPIO_REQUEST_WRITE, tid, fd, current_path.c_str(),
-                count);
-        buf_requests->write(req, CAPIO_REQ_MAX_SIZE);
+        WriteRequest req{};
+        req.header.tid = tid;
+        req.fd         = fd;
+        req.write_size = count;
+        stage_request(req, {current_path.native()});
     }
 
   public:
@@ -46,7 +47,7 @@ class WriteRequestCache {
         START_LOG(capio_syscall(SYS_gettid), "call(tid=%ld)", tid);
         if (current_fd != -1 && current_size > 0) {
             LOG("Performing write to SHM");
-            _write_request(tid, current_fd, current_size);
+            _write_request(current_size, tid, current_fd);
         }
         current_fd   = -1;
         current_size = 0;
@@ -65,12 +66,12 @@ class ReadRequestCache {
                                        const long tid, const long fd) {
         START_LOG(capio_syscall(SYS_gettid), "call(path=%s, end_of_Read=%ld, tid=%ld, fd=%ld)",
                   path.c_str(), end_of_Read, tid, fd);
-        char req[CAPIO_REQ_MAX_SIZE];
-        sprintf(req, "%04d %s %ld %ld %ld", CAPIO_REQUEST_READ, path.c_str(), tid, fd, end_of_Read);
-        LOG("Sending read request %s", req);
-        buf_requests->write(req, CAPIO_REQ_MAX_SIZE);
-        capio_off64_t res;
-        bufs_response->at(tid)->read(&res);
+        ReadRequest req{};
+        req.header.tid  = tid;
+        req.fd          = fd;
+        req.end_of_read = end_of_Read;
+        send_request(req, {path.native()});
+        capio_off64_t res = wait_reply(tid, end_of_Read);
         LOG("Response to request is %llu", res);
         return res;
     }
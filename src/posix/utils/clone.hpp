@@ -34,14 +34,14 @@ void init_process(pid_t tid) {
 
     syscall_no_intercept_flag = true;
 
-    register_listener(tid);
+    const int mailbox = register_listener(tid);
 
     const char *capio_app_name = get_capio_app_name();
     auto pid                   = static_cast<pid_t>(syscall_no_intercept(SYS_gettid));
     if (capio_app_name == nullptr) {
-        handshake_anonymous_request(tid, pid);
+        handshake_anonymous_request(tid, pid, mailbox);
     } else {
-        handshake_named_request(tid, pid, capio_app_name);
+        handshake_named_request(tid, pid, mailbox, capio_app_name);
     }
 
     syscall_no_intercept_flag = false;
@@ -64,6 +64,7 @@ void hook_clone_child() {
 
     lock.unlock();
     LOG("Starting child thread %d", tid);
+    staged_requests     = create_request_batch();
     write_request_cache = new WriteRequestCache();
     read_request_cache  = new ReadRequestCache();
 }
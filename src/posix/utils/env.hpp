@@ -1,9 +1,12 @@
 #ifndef CAPIO_POSIX_UTILS_ENV_HPP
 #define CAPIO_POSIX_UTILS_ENV_HPP
 
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
 
+#include <unistd.h>
+
 #include "capio/logger.hpp"
 
 inline const char *get_capio_app_name() {
@@ -24,4 +27,33 @@ inline capio_off64_t get_capio_write_cache_size() {
     return cache_size;
 }
 
+inline long int get_capio_request_batch_size() {
+    static char *batch_size_str = std::getenv("CAPIO_REQ_BATCH_SIZE");
+
+    static long int batch_size =
+        batch_size_str == nullptr
+            ? CAPIO_REQ_BATCH_SIZE_DEFAULT
+            : std::clamp(std::strtol(batch_size_str, nullptr, 10), 0L, CAPIO_REQ_RING_SIZE / 2);
+    return batch_size;
+}
+
+inline long int get_capio_request_batch_max_age() {
+    static char *max_age_str = std::getenv("CAPIO_REQ_BATCH_MAX_AGE");
+
+    static long int max_age = max_age_str == nullptr ? CAPIO_REQ_BATCH_MAX_AGE_DEFAULT
+                                                     : std::strtol(max_age_str, nullptr, 10);
+    return max_age;
+}
+
+// Spinning is useless if the server cannot run while the client spins, so it is disabled by
+// default on single-CPU machines
+inline long int get_capio_spin_time() {
+    static char *spin_time_str = std::getenv("CAPIO_SPIN_TIME");
+
+    static long int spin_time = spin_time_str != nullptr ? std::strtol(spin_time_str, nullptr, 10)
+                                : sysconf(_SC_NPROCESSORS_ONLN) > 1 ? CAPIO_SPIN_TIME_DEFAULT
+                                                                    : 0;
+    return spin_time;
+}
+
 #endif // CAPIO_POSIX_UTILS_ENV_HPP
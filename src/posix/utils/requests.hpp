@@ -1,16 +1,293 @@
 #ifndef CAPIO_POSIX_UTILS_REQUESTS_HPP
 #define CAPIO_POSIX_UTILS_REQUESTS_HPP
 
+#include <ctime>
 #include <utility>
 
+#include <sched.h>
+
 #include "capio/requests.hpp"
 
 #include "env.hpp"
 #include "filesystem.hpp"
 #include "types.hpp"
 
-inline CircularBuffer<char> *buf_requests;
+inline CPBufRequest_t *buf_requests;
 inline CPBufResponse_t *bufs_response;
+inline MailboxSlab *mailboxes;
+inline WakeBoard *wake_board;
+
+// Moving average of the time, in nanoseconds, the server took to reply to the calling thread
+thread_local long int reply_latency = 0;
+
+// Requests staged by the calling thread, and the time at which the oldest of them was staged
+thread_local FramedBatch *staged_requests;
+thread_local timespec staged_since;
+
+// Shard the thread publishes on, and offset of its notification lane following the last
+// notification published there by the thread
+thread_local int request_shard       = 0;
+thread_local long int notified_until = 0;
+
+inline FramedBatch *create_request_batch() {
+    return new FramedBatch(get_capio_request_batch_size() +
+                           framed_record_stride(CAPIO_REQ_MAX_SIZE));
+}
+
+/**
+ * Return the shard the calling thread publishes on. The thread follows the CPU it runs on, but
+ * leaves a shard only once the server consumed all its notifications there, so that its requests
+ * are still handled in order
+ * @return
+ */
+inline int select_request_shard() {
+    if (buf_requests->size() == 1) {
+        return 0;
+    }
+    const int cpu = sched_getcpu();
+    if (cpu >= 0 && cpu % buf_requests->size() != request_shard &&
+        buf_requests->lane(request_shard, CAPIO_REQUEST_LANE_NOTIFICATION)->head() >=
+            notified_until) {
+        request_shard  = cpu % buf_requests->size();
+        notified_until = 0;
+    }
+    return request_shard;
+}
+
+// Publish all the requests staged by the calling thread
+inline void flush_requests() {
+    START_LOG(capio_syscall(SYS_gettid), "call(count=%d)", staged_requests->count());
+    if (staged_requests->count() > 0) {
+        const int shard = select_request_shard();
+        notified_until =
+            buf_requests->lane(shard, CAPIO_REQUEST_LANE_NOTIFICATION)->write(*staged_requests);
+    }
+}
+
+// Publish the staged requests if the oldest one exceeded CAPIO_REQ_BATCH_MAX_AGE
+inline void flush_stale_requests() {
+    if (staged_requests == nullptr || staged_requests->count() == 0) {
+        return;
+    }
+    timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const long int age = (now.tv_sec - staged_since.tv_sec) * 1000000 +
+                         (now.tv_nsec - staged_since.tv_nsec) / 1000;
+    if (age >= get_capio_request_batch_max_age()) {
+        flush_requests();
+    }
+}
+
+/*
+ * Whether the staged requests must be published before syscall syscall_number, as it may block the
+ * calling thread for an unbounded time, or replace or duplicate its process
+ */
+inline bool must_flush_before(long syscall_number) {
+    switch (syscall_number) {
+#ifdef SYS_execve
+    case SYS_execve:
+#endif
+#ifdef SYS_execveat
+    case SYS_execveat:
+#endif
+#ifdef SYS_clone
+    case SYS_clone:
+#endif
+#ifdef SYS_clone3
+    case SYS_clone3:
+#endif
+#ifdef SYS_vfork
+    case SYS_vfork:
+#endif
+#ifdef SYS_read
+    case SYS_read:
+#endif
+#ifdef SYS_readv
+    case SYS_readv:
+#endif
+#ifdef SYS_recvfrom
+    case SYS_recvfrom:
+#endif
+#ifdef SYS_recvmsg
+    case SYS_recvmsg:
+#endif
+#ifdef SYS_accept
+    case SYS_accept:
+#endif
+#ifdef SYS_accept4
+    case SYS_accept4:
+#endif
+#ifdef SYS_wait4
+    case SYS_wait4:
+#endif
+#ifdef SYS_waitid
+    case SYS_waitid:
+#endif
+#ifdef SYS_nanosleep
+    case SYS_nanosleep:
+#endif
+#ifdef SYS_clock_nanosleep
+    case SYS_clock_nanosleep:
+#endif
+#ifdef SYS_pause
+    case SYS_pause:
+#endif
+#ifdef SYS_poll
+    case SYS_poll:
+#endif
+#ifdef SYS_ppoll
+    case SYS_ppoll:
+#endif
+#ifdef SYS_select
+    case SYS_select:
+#endif
+#ifdef SYS_pselect6
+    case SYS_pselect6:
+#endif
+#ifdef SYS_epoll_wait
+    case SYS_epoll_wait:
+#endif
+#ifdef SYS_epoll_pwait
+    case SYS_epoll_pwait:
+#endif
+#ifdef SYS_rt_sigsuspend
+    case SYS_rt_sigsuspend:
+#endif
+#ifdef SYS_rt_sigtimedwait
+    case SYS_rt_sigtimedwait:
+#endif
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * Publish the staged requests of the calling thread before it enters a syscall that
+ * must_flush_before(), or if they are older than CAPIO_REQ_BATCH_MAX_AGE. Called on every
+ * intercepted syscall, so that a thread that stops issuing requests does not hold them back
+ * @param syscall_number
+ */
+inline void flush_requests_before(long syscall_number) {
+    if (staged_requests == nullptr || staged_requests->count() == 0) {
+        return;
+    }
+    if (must_flush_before(syscall_number)) {
+        flush_requests();
+    } else {
+        flush_stale_requests();
+    }
+}
+
+template <class Req>
+inline char *_stage_request(const Req &req, const CapioRequestStrings<Req> &strs,
+                            const std::size_t size) {
+    START_LOG(capio_syscall(SYS_gettid), "call(code=%d, size=%zu)", Req::code, size);
+    if (size > CAPIO_REQ_MAX_SIZE) {
+        ERR_EXIT("Request %d of %zu bytes exceeds CAPIO_REQ_MAX_SIZE", Req::code, size);
+    }
+    if (staged_requests->count() == 0) {
+        clock_gettime(CLOCK_MONOTONIC, &staged_since);
+    }
+    char *dst = staged_requests->append(size);
+    if (dst == nullptr) {
+        flush_requests();
+        clock_gettime(CLOCK_MONOTONIC, &staged_since);
+        dst = staged_requests->append(size);
+    }
+    capio_encode_request(dst, req, strs);
+    return dst;
+}
+
+/**
+ * Stage @param req with its string arguments @param strs. Staged requests are published all
+ * together by the next send_request(), as soon as they exceed CAPIO_REQ_BATCH_SIZE bytes, by
+ * flush_requests_before() a syscall that may block the thread or on the first syscall after
+ * CAPIO_REQ_BATCH_MAX_AGE microseconds, or on fork and exit. Use only for notifications no other
+ * thread waits for.
+ * @tparam Req
+ * @param req
+ * @param strs
+ */
+template <class Req>
+inline void stage_request(const Req &req, const CapioRequestStrings<Req> &strs = {}) {
+    START_LOG(capio_syscall(SYS_gettid), "call(code=%d)", Req::code);
+    static_assert(Req::lane == CAPIO_REQUEST_LANE_NOTIFICATION, "Only notifications are staged");
+    _stage_request(req, strs, capio_request_size<Req>(strs));
+    if (staged_requests->size() >= get_capio_request_batch_size()) {
+        flush_requests();
+    }
+}
+
+/**
+ * Publish @param req with its string arguments @param strs on its lane, after the staged
+ * requests. Notifications are published together with the staged ones. Blocking requests carry
+ * as fence the end of the last notification of the thread, so that the server does not handle
+ * them before it. When possible, the request is encoded directly into the request buffer
+ * @tparam Req
+ * @param req
+ * @param strs
+ */
+template <class Req>
+inline void send_request(const Req &req, const CapioRequestStrings<Req> &strs = {}) {
+    START_LOG(capio_syscall(SYS_gettid), "call(code=%d)", Req::code);
+    constexpr bool blocking = Req::lane == CAPIO_REQUEST_LANE_BLOCKING;
+    const auto size         = capio_request_size<Req>(strs);
+    if (!blocking && staged_requests->count() > 0) {
+        _stage_request(req, strs, size);
+        flush_requests();
+        return;
+    }
+    if (size > CAPIO_REQ_MAX_SIZE) {
+        ERR_EXIT("Request %d of %zu bytes exceeds CAPIO_REQ_MAX_SIZE", Req::code, size);
+    }
+    flush_requests();
+
+    // selecting the shard first, as moving to another one resets the fence
+    auto lane            = buf_requests->lane(select_request_shard(), Req::lane);
+    Req request          = req;
+    request.header.fence = blocking ? notified_until : 0;
+    long int end;
+    char *dst = lane->reserve(size, &end);
+    capio_encode_request(dst, request, strs);
+    lane->commit(dst, size);
+    if (!blocking) {
+        notified_until = end;
+    }
+}
+
+/**
+ * Wait for the reply to the last request of thread @param tid. The thread spins for up to twice
+ * the average reply latency, capped to CAPIO_SPIN_TIME microseconds, before sleeping: if the
+ * server usually replies later than that, the thread sleeps right away. If the server replies
+ * with a ticket of the wake board, the thread then waits there for a value of at least
+ * @param need
+ * @param tid
+ * @param need
+ * @return
+ */
+inline capio_off64_t wait_reply(const long tid, const capio_off64_t need = 0) {
+    START_LOG(capio_syscall(SYS_gettid), "call(tid=%ld, need=%llu, reply_latency=%ld)", tid, need,
+              reply_latency);
+    const long int max_spin = get_capio_spin_time() * 1000;
+    const long int spin     = reply_latency <= max_spin ? std::min(2 * reply_latency, max_spin) : 0;
+
+    timespec start{}, end{};
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    const capio_off64_t res = MailboxSlab::wait(bufs_response->at(tid), spin);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    // long waits, as for files not yet created, must not disable spinning for too long
+    const long int latency = std::min(
+        (end.tv_sec - start.tv_sec) * 1000000000 + end.tv_nsec - start.tv_nsec, 2 * max_spin + 1);
+    reply_latency = reply_latency == 0 ? latency : (7 * reply_latency + latency) / 8;
+
+    if (WakeBoard::is_ticket(res)) {
+        LOG("Waiting on wake board");
+        return wake_board->wait(res, need, bufs_response->at(tid));
+    }
+    return res;
+}
 
 #include "cache.hpp"
 
@@ -20,9 +297,11 @@ inline CPBufResponse_t *bufs_response;
  */
 inline void init_client() {
 
-    buf_requests =
-        new CircularBuffer<char>(SHM_COMM_CHAN_NAME, CAPIO_REQ_BUFF_CNT, CAPIO_REQ_MAX_SIZE);
-    bufs_response = new CPBufResponse_t();
+    buf_requests    = new CPBufRequest_t(get_capio_request_shards());
+    bufs_response   = new CPBufResponse_t();
+    mailboxes       = new MailboxSlab(CAPIO_MAILBOX_SLAB_SIZE, get_capio_workflow_name(), false);
+    wake_board      = new WakeBoard(CAPIO_WAKE_BOARD_SLOTS, get_capio_workflow_name(), false);
+    staged_requests = create_request_batch();
 
     // TODO: use var to set cache size
     // TODO: also enable multithreading
@@ -31,14 +310,14 @@ inline void init_client() {
 }
 
 /**
- * Add a new response buffer for thread @param tid
+ * Claim a response mailbox for thread @param tid
  * @param tid
- * @return
+ * @return the index of the mailbox, to be sent to the server in the handshake
  */
-inline void register_listener(long tid) {
-    auto *p_buf_response = new CircularBuffer<capio_off64_t>(
-        SHM_COMM_CHAN_NAME_RESP + std::to_string(tid), CAPIO_REQ_BUFF_CNT, sizeof(off_t));
-    bufs_response->insert(std::make_pair(tid, p_buf_response));
+inline int register_listener(long tid) {
+    const int index = mailboxes->claim(tid);
+    bufs_response->insert(std::make_pair(tid, mailboxes->at(index, tid)));
+    return index;
 }
 
 // Block until server allows for proceeding to a generic request
@@ -46,75 +325,81 @@ inline void consent_to_proceed_request(const std::filesystem::path &path, const
                                        std::string source_func) {
     START_LOG(capio_syscall(SYS_gettid), "call(path=%s, tid=%ld, source_func=%s)", path.c_str(),
               tid, source_func.c_str());
-    char req[CAPIO_REQ_MAX_SIZE];
-    sprintf(req, "%04d %ld %s %s", CAPIO_REQUEST_CONSENT, tid, path.c_str(), source_func.c_str());
-    buf_requests->write(req, CAPIO_REQ_MAX_SIZE);
-    capio_off64_t res;
-    bufs_response->at(tid)->read(&res);
+    ConsentRequest req{};
+    req.header.tid = tid;
+    send_request(req, {path.native(), source_func});
+    wait_reply(tid);
 }
 
-// non blocking
+// non blocking, staged
 inline void close_request(const std::filesystem::path &path, const long tid) {
     START_LOG(capio_syscall(SYS_gettid), "call(path=%s, tid=%ld)", path.c_str(), tid);
     write_request_cache->flush(tid);
-    char req[CAPIO_REQ_MAX_SIZE];
-    sprintf(req, "%04d %ld %s", CAPIO_REQUEST_CLOSE, tid, path.c_str());
-    buf_requests->write(req, CAPIO_REQ_MAX_SIZE);
+    CloseRequest req{};
+    req.header.tid = tid;
+    stage_request(req, {path.native()});
 }
 
-// non blocking
+// non blocking, staged
 inline void create_request(const int fd, const std::filesystem::path &path, const long tid) {
     START_LOG(capio_syscall(SYS_gettid), "call(fd=%ld, path=%s, tid=%ld)", fd, path.c_str(), tid);
-    char req[CAPIO_REQ_MAX_SIZE];
-    sprintf(req, "%04d %ld %d %s", CAPIO_REQUEST_CREATE, tid, fd, path.c_str());
-    buf_requests->write(req, CAPIO_REQ_MAX_SIZE);
+    CreateRequest req{};
+    req.header.tid = tid;
+    req.fd         = fd;
+    stage_request(req, {path.native()});
 }
 
-// non blocking
+// non blocking, staged once the write cache of the thread is flushed and deleted
 inline void exit_group_request(const long tid) {
     START_LOG(capio_syscall(SYS_gettid), "call(tid=%ld)", tid);
-    write_request_cache->flush(tid);
-    char req[CAPIO_REQ_MAX_SIZE];
-    sprintf(req, "%04d %ld", CAPIO_REQUEST_EXIT_GROUP, tid);
-    buf_requests->write(req, CAPIO_REQ_MAX_SIZE);
+    ExitGroupRequest req{};
+    req.header.tid = tid;
+    stage_request(req);
 }
 
-// non blocking
-inline void handshake_anonymous_request(const long tid, const long pid) {
-    START_LOG(capio_syscall(SYS_gettid), "call(tid=%ld, pid=%ld)", tid, pid);
-    char req[CAPIO_REQ_MAX_SIZE];
-    sprintf(req, "%04d %ld %ld", CAPIO_REQUEST_HANDSHAKE_ANONYMOUS, tid, pid);
-    buf_requests->write(req, CAPIO_REQ_MAX_SIZE);
+// block until the server registered the thread
+inline void handshake_anonymous_request(const long tid, const long pid, const int mailbox) {
+    START_LOG(capio_syscall(SYS_gettid), "call(tid=%ld, pid=%ld, mailbox=%d)", tid, pid, mailbox);
+    HandshakeAnonymousRequest req{};
+    req.header.tid = tid;
+    req.pid        = pid;
+    req.mailbox    = mailbox;
+    send_request(req);
+    wait_reply(tid);
 }
 
-// non blocking
-inline void handshake_named_request(const long tid, const long pid, const std::string &app_name) {
-    START_LOG(capio_syscall(SYS_gettid), "call(tid=%ld, pid=%ld, app_name=%s)", tid, pid,
-              app_name.c_str());
-    char req[CAPIO_REQ_MAX_SIZE];
-    sprintf(req, "%04d %ld %ld %s", CAPIO_REQUEST_HANDSHAKE_NAMED, tid, pid, app_name.c_str());
-    buf_requests->write(req, CAPIO_REQ_MAX_SIZE);
+// block until the server registered the thread
+inline void handshake_named_request(const long tid, const long pid, const int mailbox,
+                                    const std::string &app_name) {
+    START_LOG(capio_syscall(SYS_gettid), "call(tid=%ld, pid=%ld, mailbox=%d, app_name=%s)", tid,
+              pid, mailbox, app_name.c_str());
+    HandshakeNamedRequest req{};
+    req.header.tid = tid;
+    req.pid        = pid;
+    req.mailbox    = mailbox;
+    send_request(req, {app_name});
+    wait_reply(tid);
 }
 
 // block until open is possible
 inline void open_request(const int fd, const std::filesystem::path &path, const long tid) {
     START_LOG(capio_syscall(SYS_gettid), "call(fd=%ld, path=%s, tid=%ld)", fd, path.c_str(), tid);
     write_request_cache->flush(tid);
-    char req[CAPIO_REQ_MAX_SIZE];
-    sprintf(req, "%04d %ld %d %s", CAPIO_REQUEST_OPEN, tid, fd, path.c_str());
-    buf_requests->write(req, CAPIO_REQ_MAX_SIZE);
-    capio_off64_t res;
-    bufs_response->at(tid)->read(&res);
+    OpenRequest req{};
+    req.header.tid = tid;
+    req.fd         = fd;
+    send_request(req, {path.native()});
+    wait_reply(tid);
 }
 
-// non blocking
+// non blocking, staged
 inline void rename_request(const std::filesystem::path &old_path,
                            const std::filesystem::path &new_path, const long tid) {
     START_LOG(capio_syscall(SYS_gettid), "call(old=%s, new=%s, tid=%ld)", old_path.c_str(),
               new_path.c_str(), tid);
-    char req[CAPIO_REQ_MAX_SIZE];
-    sprintf(req, "%04d %ld %s %s", CAPIO_REQUEST_RENAME, tid, old_path.c_str(), new_path.c_str());
-    buf_requests->write(req, CAPIO_REQ_MAX_SIZE);
+    RenameRequest req{};
+    req.header.tid = tid;
+    stage_request(req, {old_path.native(), new_path.native()});
 }
 
 #endif // CAPIO_POSIX_UTILS_REQUESTS_HPP
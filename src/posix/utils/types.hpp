@@ -4,12 +4,17 @@
 #include <unordered_map>
 #include <unordered_set>
 
+#include "capio/framed_queue.hpp"
+#include "capio/mailbox.hpp"
 #include "capio/queue.hpp"
+#include "capio/request_shards.hpp"
+#include "capio/wake_board.hpp"
 
 typedef std::unordered_map<int,
                            std::tuple<std::shared_ptr<capio_off64_t>, capio_off64_t, int, bool>>
     CPFiles_t;
-typedef std::unordered_map<long, CircularBuffer<capio_off64_t> *> CPBufResponse_t;
+typedef RequestShards CPBufRequest_t;
+typedef std::unordered_map<long, CapioMailbox *> CPBufResponse_t;
 typedef std::unordered_map<int, std::string> CPFileDescriptors_t;
 typedef std::unordered_map<std::string, std::unordered_set<int>> CPFilesPaths_t;
 
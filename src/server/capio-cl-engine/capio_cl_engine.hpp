@@ -1,6 +1,8 @@
 #ifndef CAPIO_ENGINE_HPP
 #define CAPIO_ENGINE_HPP
 
+#include <shared_mutex>
+
 #include "client-manager/client_manager.hpp"
 #include "utils/common.hpp"
 
@@ -19,12 +21,43 @@ class CapioCLEngine {
                                   std::vector<std::string>>> // File dependencies            [9]
         _locations;
 
+    // rules are read by all the dispatch workers, and updated when files are created
+    mutable std::shared_mutex _mutex;
+
     static std::string truncateLastN(const std::string &str, int n) {
         return str.length() > n ? "[..] " + str.substr(str.length() - n) : str;
     }
 
+    // Add an entry for @param path, inheriting its rules. The caller holds _mutex exclusively
+    void _newFile(const std::string &path) {
+        if (_locations.find(path) == _locations.end()) {
+            std::string commit = CAPIO_FILE_COMMITTED_ON_TERMINATION;
+            std::string fire   = CAPIO_FILE_MODE_UPDATE;
+
+            /*
+             * Inherit commit and fire rules from LPM directory
+             * matchSize is used to compute LPM
+             */
+            size_t matchSize = 0;
+            for (const auto &[filename, data] : _locations) {
+                if (match_globs(filename, path) && !std::get<6>(data) &&
+                    filename.length() > matchSize) {
+                    matchSize = filename.length();
+                    commit    = std::get<2>(data);
+                    fire      = std::get<3>(data);
+                }
+            }
+
+            _locations.emplace(path,
+                               std::make_tuple(std::vector<std::string>(),
+                                               std::vector<std::string>(), commit, fire, false,
+                                               false, true, -1, -1, std::vector<std::string>()));
+        }
+    }
+
   public:
     void print() const {
+        std::shared_lock<std::shared_mutex> lg(_mutex);
         std::cout << CAPIO_LOG_SERVER_CLI_LEVEL_JSON << " [ " << node_name << " ] "
                   << "Composition of expected CAPIO FS: " << std::endl
                   << std::endl
@@ -105,18 +138,24 @@ class CapioCLEngine {
     };
 
     // TODO: might need to be improved
-    static bool fileToBeHandled(std::filesystem::path::iterator::reference path) {
-        START_LOG(gettid(), "call(path=%s)", path.c_str());
+    static bool fileToBeHandled(std::string_view path) {
+        START_LOG(gettid(), "call(path=%.*s)", static_cast<int>(path.size()), path.data());
+        const std::string &capio_dir = get_capio_dir().native();
 
-        if (path == get_capio_dir()) {
+        if (path == capio_dir) {
             LOG("Path is capio_dir. Ignoring.");
             return false;
         }
 
-        LOG("Parent path=%s", path.parent_path().c_str());
-        LOG("Path %s be handled by CAPIO",
-            path.parent_path().string().rfind(get_capio_dir(), 0) == 0 ? "SHOULD" : "SHOULD NOT");
-        return path.parent_path().string().rfind(get_capio_dir(), 0) == 0;
+        // the parent directory of path must be inside capio_dir
+        const auto slash = path.rfind('/');
+        if (slash == std::string_view::npos) {
+            return false;
+        }
+        const auto parent  = path.substr(0, std::max<std::size_t>(slash, 1));
+        const bool handled = parent.substr(0, capio_dir.size()) == capio_dir;
+        LOG("Path %s be handled by CAPIO", handled ? "SHOULD" : "SHOULD NOT");
+        return handled;
     };
 
     void add(std::string &path, std::vector<std::string> &producers,
@@ -126,38 +165,19 @@ class CapioCLEngine {
         START_LOG(gettid(), "call(path=%s, commit=%s, fire=%s, permanent=%s, exclude=%s)",
                   path.c_str(), commit_rule.c_str(), fire_rule.c_str(), permanent ? "YES" : "NO",
                   exclude ? "YES" : "NO");
+        std::lock_guard<std::shared_mutex> lg(_mutex);
         _locations.emplace(path, std::make_tuple(producers, consumers, commit_rule, fire_rule,
                                                  permanent, exclude, true, -1, -1, dependencies));
     }
 
     void newFile(const std::string &path) {
         START_LOG(gettid(), "call(path=%s)", path.c_str());
-        if (_locations.find(path) == _locations.end()) {
-            std::string commit = CAPIO_FILE_COMMITTED_ON_TERMINATION;
-            std::string fire   = CAPIO_FILE_MODE_UPDATE;
-
-            /*
-             * Inherit commit and fire rules from LPM directory
-             * matchSize is used to compute LPM
-             */
-            size_t matchSize = 0;
-            for (const auto &[filename, data] : _locations) {
-                if (match_globs(filename, path) && this->isDirectory(filename) &&
-                    filename.length() > matchSize) {
-                    matchSize = filename.length();
-                    commit    = this->getCommitRule(filename);
-                    fire      = this->getFireRule(filename);
-                }
-            }
-
-            _locations.emplace(path,
-                               std::make_tuple(std::vector<std::string>(),
-                                               std::vector<std::string>(), commit, fire, false,
-                                               false, true, -1, -1, std::vector<std::string>()));
-        }
+        std::lock_guard<std::shared_mutex> lg(_mutex);
+        _newFile(path);
     }
 
-    long getDirectoryFileCount(std::string path) {
+    long getDirectoryFileCount(const std::string &path) {
+        std::shared_lock<std::shared_mutex> lg(_mutex);
         if (_locations.find(path) != _locations.end()) {
             return std::get<8>(_locations.at(path));
         }
@@ -166,8 +186,9 @@ class CapioCLEngine {
 
     void addProducer(const std::string &path, std::string &producer) {
         START_LOG(gettid(), "call(path=%s, producer=%s)", path.c_str(), producer.c_str());
+        std::lock_guard<std::shared_mutex> lg(_mutex);
         producer.erase(remove_if(producer.begin(), producer.end(), isspace), producer.end());
-        newFile(path);
+        _newFile(path);
         if (_locations.find(path) != _locations.end()) {
             std::get<0>(_locations.at(path)).emplace_back(producer);
         }
@@ -175,6 +196,7 @@ class CapioCLEngine {
 
     void addConsumer(const std::string &path, std::string &consumer) {
         START_LOG(gettid(), "call(path=%s, consumer=%s)", path.c_str(), consumer.c_str());
+        std::lock_guard<std::shared_mutex> lg(_mutex);
         consumer.erase(remove_if(consumer.begin(), consumer.end(), isspace), consumer.end());
         if (_locations.find(path) != _locations.end()) {
             std::get<1>(_locations.at(path)).emplace_back(consumer);
@@ -183,38 +205,46 @@ class CapioCLEngine {
 
     void setCommitRule(const std::string &path, const std::string &commit_rule) {
         START_LOG(gettid(), "call(path=%s, commit_rule=%s)", path.c_str(), commit_rule.c_str());
+        std::lock_guard<std::shared_mutex> lg(_mutex);
         if (_locations.find(path) != _locations.end()) {
             std::get<2>(_locations.at(path)) = commit_rule;
         }
     }
 
-    std::string getCommitRule(const std::string &path) {
+    // rules are only set while parsing the configuration, so the result stays valid
+    const std::string &getCommitRule(const std::string &path) {
+        static const std::string default_rule = CAPIO_FILE_COMMITTED_ON_TERMINATION;
         START_LOG(gettid(), "call(path=%s)", path.c_str());
+        std::shared_lock<std::shared_mutex> lg(_mutex);
         if (_locations.find(path) != _locations.end()) {
             LOG("Commit rule: %s", std::get<2>(_locations.at(path)).c_str());
             return std::get<2>(_locations.at(path));
         }
         LOG("File not present in config file. Returning default rule.");
-        return CAPIO_FILE_COMMITTED_ON_TERMINATION;
+        return default_rule;
     }
 
     void setFireRule(const std::string &path, const std::string &fire_rule) {
         START_LOG(gettid(), "call(path=%s, fire_rule=%s)", path.c_str(), fire_rule.c_str());
+        std::lock_guard<std::shared_mutex> lg(_mutex);
         if (_locations.find(path) != _locations.end()) {
             std::get<3>(_locations.at(path)) = fire_rule;
         }
     }
 
-    std::string getFireRule(const std::string &path) {
+    const std::string &getFireRule(const std::string &path) {
+        static const std::string default_rule = CAPIO_FILE_MODE_UPDATE;
         START_LOG(gettid(), "call(path=%s)", path.c_str());
+        std::shared_lock<std::shared_mutex> lg(_mutex);
         if (_locations.find(path) != _locations.end()) {
             return std::get<3>(_locations.at(path));
         }
-        return CAPIO_FILE_MODE_UPDATE;
+        return default_rule;
     }
 
     void setPermanent(const std::string &path, bool value) {
         START_LOG(gettid(), "call(path=%s, value=%s)", path.c_str(), value ? "true" : "false");
+        std::lock_guard<std::shared_mutex> lg(_mutex);
         if (_locations.find(path) != _locations.end()) {
             std::get<4>(_locations.at(path)) = value;
         }
@@ -222,6 +252,7 @@ class CapioCLEngine {
 
     void setExclude(const std::string &path, const bool value) {
         START_LOG(gettid(), "call(path=%s, value=%s)", path.c_str(), value ? "true" : "false");
+        std::lock_guard<std::shared_mutex> lg(_mutex);
         if (_locations.find(path) != _locations.end()) {
             std::get<5>(_locations.at(path)) = value;
         }
@@ -229,6 +260,7 @@ class CapioCLEngine {
 
     void setDirectory(const std::string &path) {
         START_LOG(gettid(), "call(path=%s)", path.c_str());
+        std::lock_guard<std::shared_mutex> lg(_mutex);
         if (_locations.find(path) != _locations.end()) {
             std::get<6>(_locations.at(path)) = false;
         }
@@ -236,6 +268,7 @@ class CapioCLEngine {
 
     void setFile(const std::string &path) {
         START_LOG(gettid(), "call(path=%s)", path.c_str());
+        std::lock_guard<std::shared_mutex> lg(_mutex);
         if (_locations.find(path) != _locations.end()) {
             std::get<6>(_locations.at(path)) = true;
         }
@@ -243,6 +276,7 @@ class CapioCLEngine {
 
     bool isFile(const std::string &path) const {
         START_LOG(gettid(), "call(path=%s)", path.c_str());
+        std::shared_lock<std::shared_mutex> lg(_mutex);
         if (_locations.find(path) != _locations.end()) {
             return std::get<6>(_locations.at(path));
         }
@@ -256,6 +290,7 @@ class CapioCLEngine {
 
     void setCommitedNumber(const std::string &path, const int num) {
         START_LOG(gettid(), "call(path=%s, num=%ld)", path.c_str(), num);
+        std::lock_guard<std::shared_mutex> lg(_mutex);
         if (_locations.find(path) != _locations.end()) {
             std::get<7>(_locations.at(path)) = num;
         }
@@ -263,6 +298,7 @@ class CapioCLEngine {
 
     void setDirectoryFileCount(const std::string &path, long num) {
         START_LOG(gettid(), "call(path=%s, num=%ld)", path.c_str(), num);
+        std::lock_guard<std::shared_mutex> lg(_mutex);
         if (_locations.find(path) != _locations.end()) {
             std::get<8>(_locations.at(path)) = num;
         }
@@ -270,12 +306,14 @@ class CapioCLEngine {
 
     void remove(const std::string &path) {
         START_LOG(gettid(), "call(path=%s)", path.c_str());
+        std::lock_guard<std::shared_mutex> lg(_mutex);
         _locations.erase(path);
     }
 
     // TODO: return vector
     std::vector<std::string> producers(const std::string &path) {
         START_LOG(gettid(), "call(path=%s)", path.c_str());
+        std::shared_lock<std::shared_mutex> lg(_mutex);
         if (_locations.find(path) != _locations.end()) {
             return std::get<0>(_locations.at(path));
         }
@@ -285,6 +323,7 @@ class CapioCLEngine {
     // TODO: return vector
     std::vector<std::string> consumers(const std::string &path) {
         START_LOG(gettid(), "call(path=%s)", path.c_str());
+        std::shared_lock<std::shared_mutex> lg(_mutex);
         if (_locations.find(path) != _locations.end()) {
             return std::get<1>(_locations.at(path));
         }
@@ -294,15 +333,16 @@ class CapioCLEngine {
     bool isProducer(const std::string &path, const pid_t pid) {
         START_LOG(gettid(), "call(path=%s, pid=%ld", path.c_str(), pid);
 
-        const auto app_name = client_manager->get_app_name(pid);
+        const auto &app_name = client_manager->get_app_name(pid);
         LOG("App name for tid %d is %s", pid, app_name.c_str());
+        std::shared_lock<std::shared_mutex> lg(_mutex);
 
         // check for exact entry
         if (_locations.find(path) != _locations.end()) {
             LOG("Found exact match for path");
-            std::vector<std::string> producers = std::get<0>(_locations.at(path));
-            DBG(gettid(), [&](std::vector<std::string> &arr) {
-                for (auto itm : arr) {
+            const auto &producers = std::get<0>(_locations.at(path));
+            DBG(gettid(), [&](const std::vector<std::string> &arr) {
+                for (const auto &itm : arr) {
                     LOG("producer: %s", itm.c_str());
                 }
             }(producers));
@@ -313,9 +353,9 @@ class CapioCLEngine {
         for (const auto &[k, entry] : _locations) {
             if (match_globs(k, path)) {
                 LOG("Found possible glob match");
-                std::vector<std::string> producers = std::get<0>(_locations.at(k));
-                DBG(gettid(), [&](std::vector<std::string> &arr) {
-                    for (auto itm : arr) {
+                const auto &producers = std::get<0>(entry);
+                DBG(gettid(), [&](const std::vector<std::string> &arr) {
+                    for (const auto &itm : arr) {
                         LOG("producer: %s", itm.c_str());
                     }
                 }(producers));
@@ -329,15 +369,17 @@ class CapioCLEngine {
     void setFileDeps(const std::filesystem::path &path,
                      const std::vector<std::string> &dependencies) {
         START_LOG(gettid(), "call()");
+        std::lock_guard<std::shared_mutex> lg(_mutex);
         std::get<9>(_locations.at(path)) = dependencies;
         for (const auto &itm : dependencies) {
             LOG("Creating new fie (if it exists) for path %s", itm.c_str());
-            newFile(itm);
+            _newFile(itm);
         }
     }
 
-    int getCommitCloseCount(std::filesystem::path::iterator::reference path) const {
+    int getCommitCloseCount(const std::string &path) const {
         START_LOG(gettid(), "call(path=%s)", path.c_str());
+        std::shared_lock<std::shared_mutex> lg(_mutex);
         int count = 0;
         if (_locations.find(path) != _locations.end()) {
             count = std::get<7>(_locations.at(path));
@@ -346,12 +388,14 @@ class CapioCLEngine {
         return count;
     };
 
-    // todo fix leak
-    std::vector<std::string> get_file_deps(const std::filesystem::path &path) {
+    // dependencies are only set while parsing the configuration, so the result stays valid
+    const std::vector<std::string> &get_file_deps(const std::string &path) {
+        static const std::vector<std::string> no_deps;
+        std::shared_lock<std::shared_mutex> lg(_mutex);
         if (_locations.find(path) != _locations.end()) {
             return std::get<9>(_locations.at(path));
         }
-        return {};
+        return no_deps;
     }
 };
 
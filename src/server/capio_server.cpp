@@ -144,6 +144,20 @@ std::string parseCLI(int argc, char **argv) {
     std::cout << CAPIO_LOG_SERVER_CLI_LEVEL_INFO << " [ " << node_name << " ] "
               << "CAPIO_DIR=" << get_capio_dir().c_str() << std::endl;
 
+    if (!get_capio_shm_hugetlbfs_dir().empty()) {
+        std::cout << CAPIO_LOG_SERVER_CLI_LEVEL_INFO << " [ " << node_name << " ] "
+                  << "shared memory backed by " << capio_shm_page_size() / 1024
+                  << " KiB pages from " << get_capio_shm_hugetlbfs_dir() << std::endl;
+    }
+    if (get_capio_shm_numa_node() != CAPIO_SHM_NUMA_NODE_NONE) {
+        std::cout << CAPIO_LOG_SERVER_CLI_LEVEL_INFO << " [ " << node_name << " ] "
+                  << "shared memory bound to NUMA node "
+                  << (get_capio_shm_numa_node() == CAPIO_SHM_NUMA_NODE_AUTO
+                          ? "of the dispatch thread"
+                          : std::to_string(get_capio_shm_numa_node()))
+                  << std::endl;
+    }
+
 #ifdef CAPIO_LOG
     CAPIO_LOG_LEVEL = get_capio_log_level();
     std::cout << CAPIO_LOG_SERVER_CLI_LEVEL_INFO << " [ " << node_name << " ] "
@@ -180,7 +194,6 @@ int main(int argc, char **argv) {
     capio_cl_engine         = JsonParser::parse(config_path);
     shm_canary              = new CapioShmCanary(workflow_name);
     file_manager            = new CapioFileManager();
-    fs_monitor              = new FileSystemMonitor();
     ctl_module              = new CapioCTLModule();
     request_handlers_engine = new RequestHandlerEngine();
 
@@ -1,7 +1,11 @@
 #ifndef CLIENT_MANAGER_HPP
 #define CLIENT_MANAGER_HPP
 
+#include <shared_mutex>
+
 class ClientManager {
+    MailboxSlab *mailboxes;
+    WakeBoard *wake_board;
     CSBufResponse_t *bufs_response;
     std::unordered_map<int, const std::string> *app_names;
 
@@ -9,9 +13,25 @@ class ClientManager {
     // TODO: more complex checks needs to be done but this is a temporary fix
     std::unordered_map<pid_t, std::vector<std::string> *> *files_to_be_committed_by_tid;
 
+    // taken exclusively only to register and remove clients, as dispatch workers share the maps
+    mutable std::shared_mutex clients_mutex;
+
+    // Replies received by clients while spinning and after sleeping, summed over all clients
+    unsigned long long spin_hits = 0, parks = 0;
+
+    // Broadcasts on the wake board, and threads woken up by them
+    std::atomic<unsigned long long> broadcasts = 0, broadcast_wakeups = 0;
+
+    inline void collect_wait_stats(const CapioMailbox *mailbox) {
+        spin_hits += mailbox->spin_hits.load(std::memory_order_relaxed);
+        parks += mailbox->parks.load(std::memory_order_relaxed);
+    }
+
   public:
     ClientManager() {
         START_LOG(gettid(), "call()");
+        mailboxes                    = new MailboxSlab(CAPIO_MAILBOX_SLAB_SIZE, workflow_name);
+        wake_board                   = new WakeBoard(CAPIO_WAKE_BOARD_SLOTS, workflow_name);
         bufs_response                = new CSBufResponse_t();
         app_names                    = new std::unordered_map<int, const std::string>;
         files_to_be_committed_by_tid = new std::unordered_map<pid_t, std::vector<std::string> *>;
@@ -21,7 +41,18 @@ class ClientManager {
 
     ~ClientManager() {
         START_LOG(gettid(), "call()");
+        for (const auto &[tid, mailbox] : *bufs_response) {
+            collect_wait_stats(mailbox);
+        }
+        std::cout << CAPIO_SERVER_CLI_LOG_SERVER << " [ " << node_name << " ] "
+                  << "Client replies received while spinning: " << spin_hits
+                  << ", after sleeping: " << parks << std::endl;
+        std::cout << CAPIO_SERVER_CLI_LOG_SERVER << " [ " << node_name << " ] "
+                  << "Threads woken up by broadcast: " << broadcast_wakeups << " in " << broadcasts
+                  << " broadcasts" << std::endl;
         delete bufs_response;
+        delete mailboxes;
+        delete wake_board;
         delete app_names;
         delete files_to_be_committed_by_tid;
         std::cout << CAPIO_LOG_SERVER_CLI_LEVEL_WARNING << " [ " << node_name << " ] "
@@ -29,60 +60,113 @@ class ClientManager {
     }
 
     /**
-     * Add a new response buffer for thread @param tid
+     * Register thread @param tid, whose replies are posted to mailbox @param mailbox
      * @param tid
+     * @param mailbox
+     * @param app_name
      * @return
      */
-    inline void register_new_client(pid_t tid, const std::string &app_name) const {
-        START_LOG(gettid(), "call(tid=%ld, app_name=%s)", tid, app_name.c_str());
-        // TODO: replace numbers with constexpr
-        auto *p_buf_response =
-            new CircularBuffer<capio_off64_t>(SHM_COMM_CHAN_NAME_RESP + std::to_string(tid),
-                                              CAPIO_REQ_BUFF_CNT, sizeof(off_t), workflow_name);
-        bufs_response->insert(std::make_pair(tid, p_buf_response));
+    inline void register_new_client(pid_t tid, int mailbox, const std::string &app_name) const {
+        START_LOG(gettid(), "call(tid=%ld, mailbox=%d, app_name=%s)", tid, mailbox,
+                  app_name.c_str());
+        std::lock_guard<std::shared_mutex> lg(clients_mutex);
+        (*bufs_response)[tid] = mailboxes->at(mailbox, tid);
         app_names->emplace(tid, app_name);
         files_to_be_committed_by_tid->emplace(tid, new std::vector<std::string>);
     }
 
     /**
-     * Delete the response buffer associated with thread @param tid
+     * Release the response mailbox associated with thread @param tid
      * @param tid
      * @return
      */
     inline void remove_client(pid_t tid) {
         START_LOG(gettid(), "call(tid=%ld)", tid);
+        std::lock_guard<std::shared_mutex> lg(clients_mutex);
         auto it_resp = bufs_response->find(tid);
         if (it_resp != bufs_response->end()) {
-            delete it_resp->second;
+            LOG("Replies received while spinning: %u, after sleeping: %u",
+                it_resp->second->spin_hits.load(), it_resp->second->parks.load());
+            collect_wait_stats(it_resp->second);
+            MailboxSlab::release(it_resp->second, tid);
             bufs_response->erase(it_resp);
         }
         files_to_be_committed_by_tid->erase(tid);
     }
 
     /**
-     * Write offset to response buffer of process @param tid
+     * Post offset to the response mailbox of thread @param tid
      * @param tid
      * @param offset
      * @return
      */
     inline void reply_to_client(pid_t tid, capio_off64_t offset) {
         START_LOG(gettid(), "call(tid=%ld, offset=%ld)", tid, offset);
+        std::shared_lock<std::shared_mutex> lg(clients_mutex);
+        MailboxSlab::post(bufs_response->at(tid), offset);
+    }
 
-        return bufs_response->at(tid)->write(&offset);
+    /**
+     * Make thread @param tid wait for @param event on @param path on the wake board, by replying
+     * with a ticket. The thread is then woken up by broadcast() together with the other threads
+     * waiting for the same event
+     * @param tid
+     * @param path
+     * @param event
+     * @param first whether no other thread waits for the event. Only the first thread can claim a
+     * slot, so that either all the threads waiting for the event hold a ticket or none does
+     * @return false if the file has no slot, and the thread waits for a reply_to_client() instead
+     */
+    inline bool wait_on_board(pid_t tid, const std::string &path, CapioWakeEvent event,
+                              bool first) {
+        START_LOG(gettid(), "call(tid=%ld, path=%s, first=%s)", tid, path.c_str(),
+                  first ? "yes" : "no");
+        const capio_off64_t ticket = wake_board->ticket(path, event, first);
+        if (ticket == 0) {
+            return false;
+        }
+        reply_to_client(tid, ticket);
+        return true;
+    }
+
+    // Slot of the threads waiting for @param event on @param path on the wake board, or -1
+    [[nodiscard]] inline int board_slot(const std::string &path, CapioWakeEvent event) const {
+        return wake_board->find(path, event);
     }
 
+    /**
+     * Wake up the threads waiting on slot @param slot of the wake board whose request is
+     * satisfied by @param value
+     * @param slot
+     * @param value
+     * @param woken the number of threads satisfied
+     */
+    inline void broadcast(int slot, capio_off64_t value, std::size_t woken) {
+        START_LOG(gettid(), "call(slot=%d, value=%llu, woken=%ld)", slot, value, woken);
+        wake_board->announce(slot, value);
+        broadcasts.fetch_add(1, std::memory_order_relaxed);
+        broadcast_wakeups.fetch_add(woken, std::memory_order_relaxed);
+    }
+
+    // Wake up the threads waiting on slot @param slot of the wake board, to check their mailbox
+    inline void kick(int slot) const { wake_board->kick(slot); }
+
     void add_producer_file_path(pid_t tid, std::string &path) const {
         START_LOG(gettid(), "call(tid=%ld, path=%s)", tid, path.c_str());
+        std::lock_guard<std::shared_mutex> lg(clients_mutex);
         files_to_be_committed_by_tid->at(tid)->emplace_back(path);
     }
 
     [[nodiscard]] auto get_produced_files(pid_t tid) const {
         START_LOG(gettid(), "call(tid=%ld)", tid);
+        std::shared_lock<std::shared_mutex> lg(clients_mutex);
         return files_to_be_committed_by_tid->at(tid);
     }
 
-    std::string get_app_name(pid_t tid) const {
+    // names are kept after their thread exits, so the result stays valid
+    const std::string &get_app_name(pid_t tid) const {
         START_LOG(gettid(), "call(tid=%ld)", tid);
+        std::shared_lock<std::shared_mutex> lg(clients_mutex);
         return app_names->at(tid);
     }
 };
@@ -0,0 +1,192 @@
+#ifndef CAPIO_DISPATCH_POOL_HPP
+#define CAPIO_DISPATCH_POOL_HPP
+
+#include <array>
+#include <climits>
+#include <cstddef>
+#include <cstring>
+#include <thread>
+
+#include "capio/semaphore.hpp"
+#include "utils/common.hpp"
+
+/**
+ * Request copied out of its channel, waiting for a dispatch worker. The payload has room for the
+ * largest request, so submitting a task never allocates
+ */
+struct DispatchTask {
+    CSHandler_t handler;
+    long int size;
+    int after_worker;             // worker handling the previous request of the caller, or -1
+    unsigned long long after_seq; // requests that worker must complete before this one runs
+    alignas(std::max_align_t) std::array<char, CAPIO_REQ_MAX_SIZE> payload;
+};
+
+/**
+ * Pool of threads running request handlers. Requests are assigned to workers by a key, usually
+ * the hash of the path they refer to, so requests on the same path are handled in arrival order
+ * while requests on different paths proceed in parallel. A request whose caller has an earlier
+ * request still pending on another worker waits for it, which preserves the order of the
+ * requests of every client thread.
+ * Tasks are submitted by a single dispatcher thread.
+ */
+class DispatchPool {
+    struct Worker {
+        std::vector<DispatchTask> tasks; // ring of CAPIO_DISPATCH_QUEUE_DEPTH tasks
+        unsigned long long submitted = 0;
+        std::atomic<unsigned long long> completed{0};
+        FutexWord ready{}, slots{};
+        FutexWord progress{}; // bumped every time a task is completed
+        std::thread *th = nullptr;
+    };
+
+    std::vector<Worker *> _workers;
+    std::atomic<bool> _stop{false};
+
+    // worker and sequence number of the last request of each client thread, used by the dispatcher
+    std::unordered_map<pid_t, std::pair<int, unsigned long long>> _last_requests;
+    std::size_t _sweep_at = CAPIO_DISPATCH_QUEUE_DEPTH;
+
+    std::atomic<unsigned long long> _delayed{0}; // requests that waited for another worker
+
+    // Wait until @param worker has completed @param seq tasks, or the pool is stopped
+    inline void _wait_completed(Worker *worker, unsigned long long seq) {
+        while (worker->completed.load() < seq && !_stop.load()) {
+            worker->progress.waiters.fetch_add(1);
+            const int generation = worker->progress.value.load();
+            if (worker->completed.load() < seq && !_stop.load()) {
+                capio_futex_wait(&worker->progress.value, generation);
+            }
+            worker->progress.waiters.fetch_sub(1);
+        }
+    }
+
+    static inline void _notify_progress(Worker *worker) {
+        worker->progress.value.fetch_add(1);
+        if (worker->progress.waiters.load() > 0) {
+            capio_futex(&worker->progress.value, FUTEX_WAKE, INT_MAX);
+        }
+    }
+
+    // Forget the client threads whose last request has been handled
+    inline void _sweep_last_requests() {
+        for (auto it = _last_requests.begin(); it != _last_requests.end();) {
+            const auto &[id, seq] = it->second;
+            it = _workers[id]->completed.load() >= seq ? _last_requests.erase(it) : std::next(it);
+        }
+        _sweep_at = std::max(_sweep_at, 2 * _last_requests.size());
+    }
+
+    void _main(int id) {
+        block_termination_signals();
+        START_LOG(gettid(), "INFO: instance of dispatch worker %d", id);
+        Worker *worker = _workers[id];
+        FutexSemaphore ready(&worker->ready, 0, false);
+        FutexSemaphore slots(&worker->slots, 0, false);
+
+        for (unsigned long long seq = 0;;) {
+            ready.lock();
+            if (_stop.load()) {
+                return;
+            }
+            const auto &task = worker->tasks[seq % CAPIO_DISPATCH_QUEUE_DEPTH];
+            if (task.after_worker >= 0 &&
+                _workers[task.after_worker]->completed.load() < task.after_seq) {
+                LOG("Waiting for worker %d to complete %llu requests", task.after_worker,
+                    task.after_seq);
+                _delayed.fetch_add(1, std::memory_order_relaxed);
+                _wait_completed(_workers[task.after_worker], task.after_seq);
+                if (_stop.load()) {
+                    return;
+                }
+            }
+            task.handler(task.payload.data(), task.size);
+            request_arena.reset();
+            worker->completed.store(++seq);
+            _notify_progress(worker);
+            slots.unlock();
+        }
+    }
+
+  public:
+    explicit DispatchPool(int nr_workers) {
+        START_LOG(gettid(), "call(nr_workers=%d)", nr_workers);
+
+        _workers.resize(nr_workers);
+        for (auto &worker : _workers) {
+            worker = new Worker();
+            worker->tasks.resize(CAPIO_DISPATCH_QUEUE_DEPTH);
+            FutexSemaphore(&worker->ready, 0, true);
+            FutexSemaphore(&worker->slots, CAPIO_DISPATCH_QUEUE_DEPTH, true);
+        }
+        for (int id = 0; id < nr_workers; ++id) {
+            _workers[id]->th = new std::thread(&DispatchPool::_main, this, id);
+        }
+        std::cout << CAPIO_SERVER_CLI_LOG_SERVER << " [ " << node_name << " ] "
+                  << "DispatchPool initialization completed (" << nr_workers << " workers)."
+                  << std::endl;
+    }
+
+    DispatchPool(const DispatchPool &)            = delete;
+    DispatchPool &operator=(const DispatchPool &) = delete;
+    ~DispatchPool() {
+        START_LOG(gettid(), "call()");
+        _stop.store(true);
+        for (auto worker : _workers) {
+            FutexSemaphore(&worker->ready, 0, false).unlock();
+            _notify_progress(worker);
+        }
+        for (auto worker : _workers) {
+            worker->th->join();
+            delete worker->th;
+        }
+        std::cout << CAPIO_SERVER_CLI_LOG_SERVER << " [ " << node_name << " ] "
+                  << "Requests delayed by an earlier request of their caller: " << _delayed
+                  << std::endl;
+        for (auto worker : _workers) {
+            delete worker;
+        }
+    }
+
+    [[nodiscard]] inline int size() const { return static_cast<int>(_workers.size()); }
+
+    /**
+     * Copy the request of @param size bytes stored in @param buf and queue it for handler on the
+     * worker chosen by @param key. Blocks while the queue of that worker is full
+     * @param key
+     * @param tid thread that issued the request
+     * @param handler
+     * @param buf
+     * @param size
+     */
+    inline void submit(std::size_t key, pid_t tid, CSHandler_t handler, const char *buf,
+                       long int size) {
+        const int id   = static_cast<int>(key % _workers.size());
+        Worker *worker = _workers[id];
+        START_LOG(gettid(), "call(tid=%d, size=%ld, worker=%d)", tid, size, id);
+
+        if (size > static_cast<long int>(CAPIO_REQ_MAX_SIZE)) {
+            ERR_EXIT("Request of %ld bytes exceeds CAPIO_REQ_MAX_SIZE", size);
+        }
+        FutexSemaphore(&worker->slots, 0, false).lock();
+        auto &task   = worker->tasks[worker->submitted % CAPIO_DISPATCH_QUEUE_DEPTH];
+        task.handler = handler;
+        task.size    = size;
+        memcpy(task.payload.data(), buf, size);
+        task.after_worker = -1;
+
+        auto [last, inserted] = _last_requests.try_emplace(tid, id, 0);
+        if (!inserted && last->second.first != id) {
+            task.after_worker = last->second.first;
+            task.after_seq    = last->second.second;
+        }
+        last->second = {id, ++worker->submitted};
+        if (_last_requests.size() >= _sweep_at) {
+            _sweep_last_requests();
+        }
+
+        FutexSemaphore(&worker->ready, 0, false).unlock();
+    }
+};
+
+#endif // CAPIO_DISPATCH_POOL_HPP
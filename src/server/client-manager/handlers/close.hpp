@@ -1,34 +1,38 @@
 #ifndef CAPIO_CLOSE_HPP
 #define CAPIO_CLOSE_HPP
 
-inline void close_handler(const char *const str) {
-    pid_t tid;
-    char path[PATH_MAX];
-    sscanf(str, "%d %s", &tid, path);
+// Commit job.path, closed by one of its producers
+inline void close_probe(const ProbeJob &job) {
+    START_LOG(gettid(), "call(tid=%d, path=%s)", job.tid, job.path.c_str());
+    // The increase close count is called only on explicit close() sc, as defined by the
+    // CAPIO-CL specification. If it were to be called every time the file is committed, then
+    // an extra increase would occur as by default, at termination all files are committed.
+    // By calling this only when close sc are occurred, we guarantee the correct count of
+    // how many close sc occurs.
+    file_manager->increaseCloseCount(job.path);
+    // counted first, so that the waiting threads see this close
+    file_manager->setCommitted(job.path);
+}
 
-    START_LOG(gettid(), "call(tid=%d, path=%s)", tid, path);
+inline void close_handler(const CapioRequestView<CloseRequest> &request) {
+    const pid_t tid  = request->header.tid;
+    const char *path = request.str[0];
 
-    std::filesystem::path filename(path);
+    START_LOG(gettid(), "call(tid=%d, path=%s)", tid, path);
 
-    if (!CapioCLEngine::fileToBeHandled(filename)) {
+    if (!CapioCLEngine::fileToBeHandled(path)) {
         LOG("File should not be handled");
         return;
     }
 
     LOG("File needs handling");
+    const std::string &filename = request_arena.string(path);
 
     // Call the set_committed method only if the commit rule is on_close and calling thread is a
     // producer
     if (capio_cl_engine->getCommitRule(filename) == CAPIO_FILE_COMMITTED_ON_CLOSE &&
         capio_cl_engine->isProducer(filename, tid)) {
-        file_manager->setCommitted(path);
-
-        // The increase close count is called only on explicit close() sc, as defined by the
-        // CAPIO-CL specification. If it were to be called every time the file is committed, then
-        // an extra increase would occur as by default, at termination all files are committed.
-        // By calling this only when close sc are occurred, we guarantee the correct count of
-        // how many close sc occurs.
-        CapioFileManager::increaseCloseCount(path);
+        submit_probe(close_probe, tid, path);
     }
 }
 
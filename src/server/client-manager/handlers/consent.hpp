@@ -4,31 +4,17 @@
 This handler only checks if the client is allowed to continue
 */
 
-inline void consent_to_proceed_handler(const char *const str) {
-    pid_t tid;
-    char path[1024], source_func[1024];
-    sscanf(str, "%d %s %s", &tid, path, source_func);
-    START_LOG(gettid(), "call(tid=%d, path=%s, source=%s)", tid, path, source_func);
-
-    std::filesystem::path path_fs(path);
-
-    // Skip operations on CAPIO_DIR
-    if (!CapioCLEngine::fileToBeHandled(path_fs)) {
-        LOG("Ignore calls as file should not be treated by CAPIO");
-        client_manager->reply_to_client(tid, 1);
-        return;
-    }
-    if (capio_cl_engine->isProducer(path, tid)) {
-        LOG("Application is producer. continuing");
-        client_manager->reply_to_client(tid, 1);
-        return;
-    }
+// Decide whether thread job.tid can proceed once job.path has been looked up
+inline void consent_to_proceed_probe(const ProbeJob &job) {
+    const pid_t tid         = job.tid;
+    const std::string &path = job.path;
+    START_LOG(gettid(), "call(tid=%d, path=%s)", tid, path.c_str());
 
     // TODO: check this expression as being the correct evaluation one
     // NOTE: expression is (exists AND (committed OR no_update))
 
-    bool exists    = std::filesystem::exists(path);
-    bool committed = CapioFileManager::isCommitted(path);
+    bool exists    = file_manager->exists(path);
+    bool committed = exists && file_manager->isCommitted(path);
     bool firable   = capio_cl_engine->getFireRule(path) == CAPIO_FILE_MODE_NO_UPDATE;
 
     LOG("exists=%s, committed=%s, firable=%s", exists ? "true" : "false",
@@ -38,9 +24,29 @@ inline void consent_to_proceed_handler(const char *const str) {
         LOG("It is possible to unlock waiting thread");
         client_manager->reply_to_client(tid, 1);
     } else {
-        LOG("Requested file %s does not exists yet. awaiting for creation", path);
-        file_manager->addThreadAwaitingData(path, tid, 0);
+        LOG("Requested file %s does not exists yet. awaiting for creation", path.c_str());
+        file_manager->await(CAPIO_WAIT_DATA, path, tid);
+    }
+}
+
+inline void consent_to_proceed_handler(const CapioRequestView<ConsentRequest> &request) {
+    const pid_t tid                          = request->header.tid;
+    const char *path                         = request.str[0];
+    [[maybe_unused]] const char *source_func = request.str[1];
+    START_LOG(gettid(), "call(tid=%d, path=%s, source=%s)", tid, path, source_func);
+
+    // Skip operations on CAPIO_DIR
+    if (!CapioCLEngine::fileToBeHandled(path)) {
+        LOG("Ignore calls as file should not be treated by CAPIO");
+        client_manager->reply_to_client(tid, 1);
+        return;
+    }
+    if (capio_cl_engine->isProducer(request_arena.string(path), tid)) {
+        LOG("Application is producer. continuing");
+        client_manager->reply_to_client(tid, 1);
+        return;
     }
+    submit_probe(consent_to_proceed_probe, tid, path);
 }
 
 #endif // CONSENT_HPP
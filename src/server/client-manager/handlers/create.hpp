@@ -1,14 +1,23 @@
 #ifndef CAPIO_CREATE_HPP
 #define CAPIO_CREATE_HPP
 
-inline void create_handler(const char *const str) {
-    pid_t tid, fd;
-    char path[PATH_MAX];
-    sscanf(str, "%d %d %s", &tid, &fd, path);
+// Wake up the threads waiting for data of job.path, or of its directory, now that it exists
+inline void create_probe(const ProbeJob &job) {
+    START_LOG(gettid(), "call(tid=%d, path=%s)", job.tid, job.path.c_str());
+    file_manager->fileChanged(job.path);
+    file_manager->unlockProducersAwaitingData(job.path);
+}
+
+inline void create_handler(const CapioRequestView<CreateRequest> &request) {
+    const pid_t tid  = request->header.tid;
+    const char *path = request.str[0];
     START_LOG(gettid(), "call(tid=%d, path=%s)", tid, path);
-    file_manager->unlockThreadAwaitingCreation(path);
+    file_manager->setCreated(path);
     std::string name(client_manager->get_app_name(tid));
     capio_cl_engine->addProducer(path, name);
+    if (file_manager->fileCreated(path)) {
+        submit_probe(create_probe, tid, path);
+    }
 }
 
 #endif // CAPIO_CREATE_HPP
@@ -1,18 +1,24 @@
 #ifndef CAPIO_EXIT_HPP
 #define CAPIO_EXIT_HPP
 
-inline void exit_handler(const char *const str) {
-    // TODO: register files open for each tid ti register a close
-    pid_t tid;
-    sscanf(str, "%d", &tid);
-    START_LOG(gettid(), "call(tid=%d)", tid);
-
+// Commit the files produced by job.tid, which terminated, then forget the thread
+inline void exit_probe(const ProbeJob &job) {
+    START_LOG(gettid(), "call(tid=%d)", job.tid);
     // At exit, all files are considered to be committed. hence, call the set_committed
     // method. The increase_close_count method is not called, as it would add a close count
     // to a file that might have already been closing (hence increasing the close count by an extra
     // close
-    file_manager->setCommitted(tid);
-    client_manager->remove_client(tid);
+    file_manager->setCommitted(job.tid);
+    // the files produced by the thread are known only until it is removed
+    client_manager->remove_client(job.tid);
+}
+
+inline void exit_handler(const CapioRequestView<ExitGroupRequest> &request) {
+    // TODO: register files open for each tid ti register a close
+    const pid_t tid = request->header.tid;
+    START_LOG(gettid(), "call(tid=%d)", tid);
+
+    submit_probe(exit_probe, tid, "");
 }
 
 #endif // CAPIO_EXIT_HPP
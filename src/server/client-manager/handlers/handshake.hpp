@@ -3,19 +3,25 @@
 
 #include "capio/constants.hpp"
 
-inline void handshake_anonymous_handler(const char *const str) {
-    pid_t tid, pid;
-    sscanf(str, "%d %d", &tid, &pid);
-    START_LOG(gettid(), "call(tid=%ld, pid=%ld)", tid, pid);
-    client_manager->register_new_client(tid, CAPIO_DEFAULT_APP_NAME);
+inline void
+handshake_anonymous_handler(const CapioRequestView<HandshakeAnonymousRequest> &request) {
+    const pid_t tid                  = request->header.tid;
+    [[maybe_unused]] const pid_t pid = request->pid;
+    const int mailbox                = request->mailbox;
+    START_LOG(gettid(), "call(tid=%ld, pid=%ld, mailbox=%d)", tid, pid, mailbox);
+    client_manager->register_new_client(tid, mailbox, CAPIO_DEFAULT_APP_NAME);
+    client_manager->reply_to_client(tid, 1);
 }
 
-inline void handshake_named_handler(const char *const str) {
-    pid_t tid, pid;
-    char app_name[1024];
-    sscanf(str, "%d %d %s", &tid, &pid, app_name);
-    START_LOG(gettid(), "call(tid=%ld, pid=%ld, app_name=%s)", tid, pid, app_name);
-    client_manager->register_new_client(tid, app_name);
+inline void handshake_named_handler(const CapioRequestView<HandshakeNamedRequest> &request) {
+    const pid_t tid                  = request->header.tid;
+    [[maybe_unused]] const pid_t pid = request->pid;
+    const int mailbox                = request->mailbox;
+    const char *app_name             = request.str[0];
+    START_LOG(gettid(), "call(tid=%ld, pid=%ld, mailbox=%d, app_name=%s)", tid, pid, mailbox,
+              app_name);
+    client_manager->register_new_client(tid, mailbox, app_name);
+    client_manager->reply_to_client(tid, 1);
 }
 
 #endif // HANDSHAKE_HPP
@@ -1,16 +1,29 @@
 #ifndef OPEN_HPP
 #define OPEN_HPP
-inline void open_handler(const char *const str) {
-    pid_t tid;
-    int fd;
-    char path[PATH_MAX];
-    sscanf(str, "%d %d %s", &tid, &fd, path);
+
+// Let thread job.tid proceed if job.path exists, otherwise wait for its creation
+inline void open_probe(const ProbeJob &job) {
+    const pid_t tid         = job.tid;
+    const std::string &path = job.path;
+    START_LOG(gettid(), "call(tid=%d, path=%s)", tid, path.c_str());
+
+    if (file_manager->exists(path)) {
+        client_manager->reply_to_client(tid, 1);
+    } else {
+        file_manager->await(CAPIO_WAIT_CREATION, path, tid);
+    }
+}
+
+inline void open_handler(const CapioRequestView<OpenRequest> &request) {
+    const pid_t tid               = request->header.tid;
+    [[maybe_unused]] const int fd = request->fd;
+    const char *path              = request.str[0];
     START_LOG(gettid(), "call(tid=%d, fd=%d, path=%s", tid, fd, path);
 
-    if (std::filesystem::exists(path) || capio_cl_engine->isProducer(path, tid)) {
+    if (capio_cl_engine->isProducer(request_arena.string(path), tid)) {
         client_manager->reply_to_client(tid, 1);
     } else {
-        file_manager->addThreadAwaitingCreation(path, tid);
+        submit_probe(open_probe, tid, path);
     }
 }
 #endif // OPEN_HPP
@@ -2,33 +2,39 @@
 #define READ_HPP
 #include "file-manager/file_manager_impl.hpp"
 
-inline void read_handler(const char *const str) {
-    pid_t tid;
-    int fd;
-    capio_off64_t end_of_read;
-    char path[PATH_MAX];
+// Reply with the size of job.path once it holds job.offset bytes or it is committed
+inline void read_probe(const ProbeJob &job) {
+    const pid_t tid                 = job.tid;
+    const capio_off64_t end_of_read = job.offset;
+    const std::string &path         = job.path;
+    START_LOG(gettid(), "call(path=%s, tid=%ld, end_of_read=%llu)", path.c_str(), tid,
+              end_of_read);
 
-    sscanf(str, "%s %d %d %llu", path, &tid, &fd, &end_of_read);
-    START_LOG(gettid(), "call(path=%s, tid=%ld, end_of_read=%llu)", path, tid, end_of_read);
-
-    std::filesystem::path path_fs(path);
-    // Skip operations on CAPIO_DIR
-    if (!CapioCLEngine::fileToBeHandled(path_fs)) {
-        LOG("Ignore calls as file should not be treated by CAPIO");
-        client_manager->reply_to_client(tid, 1);
-        return;
-    }
-
-    auto is_committed = CapioFileManager::isCommitted(path);
-    auto file_size    = CapioFileManager::get_file_size_if_exists(path);
+    auto is_committed = file_manager->isCommitted(path);
+    auto file_size    = is_committed ? ULLONG_MAX : file_manager->getFileSize(path, end_of_read);
 
     // return ULLONG_MAX to signal client cache that file is committed and no more requests are
     // required
     if (file_size >= end_of_read || is_committed || capio_cl_engine->isProducer(path, tid)) {
         client_manager->reply_to_client(tid, is_committed ? ULLONG_MAX : file_size);
     } else {
-        file_manager->addThreadAwaitingData(path, tid, end_of_read);
+        file_manager->await(CAPIO_WAIT_DATA, path, tid, end_of_read);
+    }
+}
+
+inline void read_handler(const CapioRequestView<ReadRequest> &request) {
+    const pid_t tid                 = request->header.tid;
+    const capio_off64_t end_of_read = request->end_of_read;
+    const char *path                = request.str[0];
+    START_LOG(gettid(), "call(path=%s, tid=%ld, end_of_read=%llu)", path, tid, end_of_read);
+
+    // Skip operations on CAPIO_DIR
+    if (!CapioCLEngine::fileToBeHandled(path)) {
+        LOG("Ignore calls as file should not be treated by CAPIO");
+        client_manager->reply_to_client(tid, 1);
+        return;
     }
+    submit_probe(read_probe, tid, path, end_of_read);
 }
 
 #endif // READ_HPP
@@ -1,12 +1,21 @@
 #ifndef CAPIO_RENAME_HPP
 #define CAPIO_RENAME_HPP
 
-inline void rename_handler(const char *const str) {
-    pid_t tid;
-    char old_path[PATH_MAX], new_path[PATH_MAX];
-    sscanf(str, "%d %s %s", &tid, old_path, new_path);
+// Wake up the threads waiting for data of job.path, or of its directory, now that it exists
+inline void rename_probe(const ProbeJob &job) {
+    START_LOG(gettid(), "call(tid=%d, path=%s)", job.tid, job.path.c_str());
+    file_manager->fileChanged(job.path);
+}
+
+inline void rename_handler(const CapioRequestView<RenameRequest> &request) {
+    const pid_t tid      = request->header.tid;
+    const char *old_path = request.str[0];
+    const char *new_path = request.str[1];
     START_LOG(gettid(), "call(tid=%d, old=%s, new=%s)", tid, old_path, new_path);
-    file_manager->unlockThreadAwaitingCreation(new_path);
+    file_manager->renameState(old_path, new_path);
+    if (file_manager->fileCreated(new_path)) {
+        submit_probe(rename_probe, tid, new_path);
+    }
     // TODO: gestire le rename?
 }
 
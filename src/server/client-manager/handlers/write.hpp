@@ -2,22 +2,28 @@
 #define WRITE_HPP
 #include "capio-cl-engine/capio_cl_engine.hpp"
 
-inline void write_handler(const char *const str) {
-    pid_t tid;
-    int fd;
-    capio_off64_t write_size;
+// Wake up the threads waiting for data of job.path that is now available
+inline void write_probe(const ProbeJob &job) {
+    START_LOG(gettid(), "call(tid=%d, path=%s)", job.tid, job.path.c_str());
+    file_manager->fileChanged(job.path);
+}
 
-    char path[PATH_MAX];
-    sscanf(str, "%d %d %s %llu", &tid, &fd, path, &write_size);
+inline void write_handler(const CapioRequestView<WriteRequest> &request) {
+    const pid_t tid                = request->header.tid;
+    [[maybe_unused]] const int fd  = request->fd;
+    const capio_off64_t write_size = request->write_size;
+    const char *path               = request.str[0];
     START_LOG(gettid(), "call(tid=%d, fd=%d, path=%s, count=%llu)", tid, fd, path, write_size);
-    std::filesystem::path filename(path);
-
-    if (!CapioCLEngine::fileToBeHandled(filename)) {
+    // a write of no bytes makes no new data available
+    if (write_size == 0 || !CapioCLEngine::fileToBeHandled(path)) {
         return;
     }
 
     LOG("File needs to be handled");
-    file_manager->checkAndUnlockThreadAwaitingData(path);
+    // waiting threads check the file again after registering, so none is missed here
+    if (file_manager->hasThreadAwaitingData(request_arena.string(path))) {
+        submit_probe(write_probe, tid, path);
+    }
 }
 
 #endif // WRITE_HPP
@@ -5,7 +5,10 @@
 #include "capio-cl-engine/json_parser.hpp"
 #include "capio/requests.hpp"
 #include "client_manager.hpp"
+#include "dispatch_pool.hpp"
+#include "write_coalescer.hpp"
 #include "file-manager/file_manager.hpp"
+#include "file-manager/probe_pool.hpp"
 
 /*
  * REQUESTS handlers
@@ -20,47 +23,226 @@
 #include "handlers/rename.hpp"
 #include "handlers/write.hpp"
 
+/**
+ * Depth of a request lane, sampled every time a request is taken from it
+ */
+struct RequestLaneStats {
+    unsigned long long requests = 0, depth_sum = 0;
+    long int max_depth = 0;
+
+    inline void sample(long int depth) {
+        requests++;
+        depth_sum += depth;
+        max_depth = std::max(max_depth, depth);
+    }
+
+    [[nodiscard]] inline double average_depth() const {
+        return requests == 0 ? 0 : static_cast<double>(depth_sum) / requests;
+    }
+};
+
 class RequestHandlerEngine {
     std::array<CSHandler_t, CAPIO_NR_REQUESTS> request_handlers{};
+    std::array<CSRoute_t, CAPIO_NR_REQUESTS> request_routes{};
     CSBufRequest_t *buf_requests;
+    DispatchPool *dispatch_pool = nullptr; // requests are handled in place when not set
+    RequestLaneStats blocking_stats, notification_stats;
+    unsigned long long fenced_requests = 0; // blocking requests delayed by their own notifications
+
+    WriteCoalescer pending_writes; // write notifications held back in this pass
 
     static constexpr std::array<CSHandler_t, CAPIO_NR_REQUESTS> build_request_handlers_table() {
         std::array<CSHandler_t, CAPIO_NR_REQUESTS> _request_handlers{0};
 
-        _request_handlers[CAPIO_REQUEST_CONSENT]             = consent_to_proceed_handler;
-        _request_handlers[CAPIO_REQUEST_CLOSE]               = close_handler;
-        _request_handlers[CAPIO_REQUEST_CREATE]              = create_handler;
-        _request_handlers[CAPIO_REQUEST_EXIT_GROUP]          = exit_handler;
-        _request_handlers[CAPIO_REQUEST_HANDSHAKE_NAMED]     = handshake_named_handler;
-        _request_handlers[CAPIO_REQUEST_HANDSHAKE_ANONYMOUS] = handshake_anonymous_handler;
-        _request_handlers[CAPIO_REQUEST_MKDIR]               = create_handler;
-        _request_handlers[CAPIO_REQUEST_OPEN]                = open_handler;
-        _request_handlers[CAPIO_REQUEST_READ]                = read_handler;
-        _request_handlers[CAPIO_REQUEST_RENAME]              = rename_handler;
-        _request_handlers[CAPIO_REQUEST_WRITE]               = write_handler;
+        _request_handlers[CAPIO_REQUEST_CONSENT] =
+            dispatch<ConsentRequest, consent_to_proceed_handler>;
+        _request_handlers[CAPIO_REQUEST_CLOSE]      = dispatch<CloseRequest, close_handler>;
+        _request_handlers[CAPIO_REQUEST_CREATE]     = dispatch<CreateRequest, create_handler>;
+        _request_handlers[CAPIO_REQUEST_EXIT_GROUP] = dispatch<ExitGroupRequest, exit_handler>;
+        _request_handlers[CAPIO_REQUEST_HANDSHAKE_NAMED] =
+            dispatch<HandshakeNamedRequest, handshake_named_handler>;
+        _request_handlers[CAPIO_REQUEST_HANDSHAKE_ANONYMOUS] =
+            dispatch<HandshakeAnonymousRequest, handshake_anonymous_handler>;
+        _request_handlers[CAPIO_REQUEST_MKDIR]  = dispatch<CreateRequest, create_handler>;
+        _request_handlers[CAPIO_REQUEST_OPEN]   = dispatch<OpenRequest, open_handler>;
+        _request_handlers[CAPIO_REQUEST_READ]   = dispatch<ReadRequest, read_handler>;
+        _request_handlers[CAPIO_REQUEST_RENAME] = dispatch<RenameRequest, rename_handler>;
+        _request_handlers[CAPIO_REQUEST_WRITE]  = dispatch<WriteRequest, write_handler>;
 
         return _request_handlers;
     }
 
+    static constexpr std::array<CSRoute_t, CAPIO_NR_REQUESTS> build_request_routes_table() {
+        std::array<CSRoute_t, CAPIO_NR_REQUESTS> _request_routes{0};
+
+        _request_routes[CAPIO_REQUEST_CONSENT]             = route<ConsentRequest>;
+        _request_routes[CAPIO_REQUEST_CLOSE]               = route<CloseRequest>;
+        _request_routes[CAPIO_REQUEST_CREATE]              = route<CreateRequest>;
+        _request_routes[CAPIO_REQUEST_EXIT_GROUP]          = route<ExitGroupRequest>;
+        _request_routes[CAPIO_REQUEST_HANDSHAKE_NAMED]     = route<HandshakeNamedRequest, -1>;
+        _request_routes[CAPIO_REQUEST_HANDSHAKE_ANONYMOUS] = route<HandshakeAnonymousRequest>;
+        _request_routes[CAPIO_REQUEST_MKDIR]               = route<CreateRequest>;
+        _request_routes[CAPIO_REQUEST_OPEN]                = route<OpenRequest>;
+        _request_routes[CAPIO_REQUEST_READ]                = route<ReadRequest>;
+        // the rename handler wakes up the threads waiting for the new path
+        _request_routes[CAPIO_REQUEST_RENAME]              = route<RenameRequest, 1>;
+        _request_routes[CAPIO_REQUEST_WRITE]               = route<WriteRequest>;
+
+        return _request_routes;
+    }
+
     /**
-     * Read next incoming request into @param str and returns the request code
-     * @param str
-     * @return request code
+     * Decode the request of @param size bytes stored in @param buf as a Req, and forward a typed
+     * view of it to handler, recording how long it ran
+     * @param buf
+     * @param size
      */
-    inline auto read_next_request(char *str) const {
-        char req[CAPIO_REQ_MAX_SIZE];
-        buf_requests->read(req);
-        START_LOG(gettid(), "call(req=%s)", req);
-        int code       = -1;
-        auto [ptr, ec] = std::from_chars(req, req + 4, code);
-        if (ec == std::errc()) {
-            strcpy(str, ptr + 1);
+    template <class Req, void (*handler)(const CapioRequestView<Req> &)>
+    static void dispatch(const char *const buf, const long int size) {
+        START_LOG(gettid(), "call(code=%d, size=%ld)", Req::code, size);
+        CapioRequestView<Req> request{};
+        if (!capio_decode_request(buf, size, &request)) {
+            std::cout << CAPIO_LOG_SERVER_CLI_LEVEL_ERROR << " [ " << node_name << " ] "
+                      << "Received malformed request with code: " << Req::code << std::endl;
+            ERR_EXIT("Malformed request of %ld bytes with code %d", size, Req::code);
+        }
+        const long int start = capio_monotonic_ns();
+        handler(request);
+        request_stats.served(Req::code, capio_monotonic_ns() - start);
+    }
+
+    /**
+     * Compute the key used to assign the request of @param size bytes stored in @param buf to a
+     * dispatch worker: the hash of its string argument arg, or of the caller tid if arg is negative
+     * or the request has no strings. Requests sharing a key are handled in arrival order
+     * @param buf
+     * @param size
+     */
+    template <class Req, int arg = 0>
+    static std::size_t route(const char *const buf, const long int size) {
+        if constexpr (arg >= 0 && arg < Req::nr_strings) {
+            CapioRequestView<Req> request{};
+            if (capio_decode_request(buf, size, &request)) {
+                return std::hash<std::string_view>{}(request.str[arg]);
+            }
+        }
+        // malformed requests are reported by their handler
+        return std::hash<pid_t>{}(reinterpret_cast<const CapioRequestHeader *>(buf)->tid);
+    }
+
+    /**
+     * Access in place the next request of @param lane, without copying it out of the channel. The
+     * request must be released once it has been handled
+     * @param lane
+     * @param buf set to the start of the request
+     * @param size set to the size of the request
+     * @param header set to the header of the request
+     */
+    static inline void acquire_next_request(FramedQueue *lane, const char **buf, long int *size,
+                                            CapioRequestHeader *header) {
+        *buf = lane->acquire(size);
+        START_LOG(gettid(), "call(size=%ld)", *size);
+        *header = {};
+        if (*size >= static_cast<long int>(sizeof(CapioRequestHeader))) {
+            memcpy(header, *buf, sizeof(CapioRequestHeader));
+        }
+        if (header->version != CAPIO_REQUEST_PROTOCOL_VERSION) {
+            std::cout << CAPIO_LOG_SERVER_CLI_LEVEL_ERROR << " [ " << node_name << " ] "
+                      << "Received request with unsupported protocol version: " << header->version
+                      << std::endl;
+            ERR_EXIT("Invalid request version %d (size=%ld)", header->version, *size);
+        }
+    }
+
+    // Run the handler of the request of @param size bytes stored in @param buf, or queue it
+    inline void run_handler(const CapioRequestHeader &header, const char *buf, long int size) {
+        if (dispatch_pool == nullptr) {
+            // handlers copy whatever they need to keep, so the slot can be reused afterwards
+            request_handlers[header.code](buf, size);
+            request_arena.reset();
         } else {
+            dispatch_pool->submit(request_routes[header.code](buf, size), header.tid,
+                                  request_handlers[header.code], buf, size);
+        }
+    }
+
+    /**
+     * Hold back the write notification of @param size bytes stored in @param buf, merging it into
+     * the one already held back for the same thread, file descriptor and path: write handlers
+     * only check the threads waiting for the file, so the last write of a batch stands for all the
+     * previous ones
+     * @param header
+     * @param buf
+     * @param size
+     */
+    inline void hold_write(const CapioRequestHeader &header, const char *buf, long int size) {
+        START_LOG(gettid(), "call(tid=%d, size=%ld)", header.tid, size);
+        CapioRequestView<WriteRequest> request{};
+        if (!capio_decode_request(buf, size, &request)) {
+            // malformed requests are reported by their handler
+            run_handler(header, buf, size);
+            return;
+        }
+        if (pending_writes.hold(request, buf, size)) {
+            request_stats.coalesced();
+        }
+    }
+
+    // Handle the write notifications held back, in the order they were first received
+    inline void flush_writes() {
+        pending_writes.flush([this](const CapioRequestHeader &header, const char *buf,
+                                    long int size) { run_handler(header, buf, size); });
+    }
+
+    /**
+     * Handle the next request of lane @param lane of shard @param shard in place, then release
+     * it. Before a blocking request, the notifications its caller published earlier are handled.
+     * Write notifications are held back until the end of the pass, or until another request
+     * comes, so that the writes on the same path are handled once
+     * @param shard
+     * @param lane
+     */
+    inline void handle_next_request(int shard, int lane) {
+        START_LOG(gettid(), "call(shard=%d, lane=%d)", shard, lane);
+        LOG(CAPIO_LOG_SERVER_REQUEST_START);
+        auto channel = buf_requests->lane(shard, lane);
+        (lane == CAPIO_REQUEST_LANE_BLOCKING ? blocking_stats : notification_stats)
+            .sample(channel->available());
+
+        const char *buf;
+        long int size;
+        CapioRequestHeader header{};
+        acquire_next_request(channel, &buf, &size, &header);
+        if (header.code >= CAPIO_NR_REQUESTS || request_handlers[header.code] == nullptr) {
             std::cout << CAPIO_LOG_SERVER_CLI_LEVEL_ERROR << " [ " << node_name << " ] "
-                      << "Received invalid code: " << code << std::endl;
-            ERR_EXIT("Invalid request %d%s", code, ptr);
+                      << "Received invalid code: " << header.code << std::endl;
+
+            ERR_EXIT("Error: received invalid request code");
+        }
+        request_stats.queued(header.code, capio_monotonic_ns() - header.sent_at);
+        auto notifications = buf_requests->lane(shard, CAPIO_REQUEST_LANE_NOTIFICATION);
+        if (lane == CAPIO_REQUEST_LANE_BLOCKING && notifications->head() < header.fence) {
+            LOG("Handling notifications up to fence %ld first", header.fence);
+            fenced_requests++;
+            while (notifications->head() < header.fence) {
+                handle_next_request(shard, CAPIO_REQUEST_LANE_NOTIFICATION);
+            }
         }
-        return code;
+        if (header.code == CAPIO_REQUEST_WRITE) {
+            hold_write(header, buf, size);
+        } else {
+            // only writes are reordered, and only among themselves
+            flush_writes();
+            run_handler(header, buf, size);
+        }
+        channel->release();
+        LOG(CAPIO_LOG_SERVER_REQUEST_END);
+    }
+
+    static inline void print_lane_stats(const char *name, const RequestLaneStats &stats) {
+        std::cout << CAPIO_SERVER_CLI_LOG_SERVER << " [ " << node_name << " ] " << name
+                  << " lane: " << stats.requests << " requests, average depth "
+                  << stats.average_depth() << ", max depth " << stats.max_depth << std::endl;
     }
 
   public:
@@ -69,8 +251,20 @@ class RequestHandlerEngine {
 
         client_manager   = new ClientManager();
         request_handlers = build_request_handlers_table();
-        buf_requests     = new CSBufRequest_t(SHM_COMM_CHAN_NAME, CAPIO_REQ_BUFF_CNT,
-                                              CAPIO_REQ_MAX_SIZE, workflow_name);
+        request_routes   = build_request_routes_table();
+        buf_requests     = new CSBufRequest_t(get_capio_request_shards(), workflow_name);
+        if (buf_requests->size() != get_capio_request_shards()) {
+            std::cout << CAPIO_LOG_SERVER_CLI_LEVEL_WARNING << " [ " << node_name << " ] "
+                      << "Request channels were created by a client: using "
+                      << buf_requests->size() << " shards" << std::endl;
+        }
+        fs_monitor = new FileSystemMonitor();
+        if (get_capio_probe_workers() > 0) {
+            probe_pool = new ProbePool(get_capio_probe_workers());
+        }
+        if (get_capio_dispatch_workers() > 0) {
+            dispatch_pool = new DispatchPool(get_capio_dispatch_workers());
+        }
 
         std::cout << CAPIO_SERVER_CLI_LOG_SERVER << " [ " << node_name << " ] "
                   << "RequestHandlerEngine initialization completed." << std::endl;
@@ -78,27 +272,82 @@ class RequestHandlerEngine {
 
     ~RequestHandlerEngine() {
         START_LOG(gettid(), "call()");
+        // handlers still queued are dropped: their callers are going to fail anyway
+        delete dispatch_pool;
+        delete probe_pool;
+        // the monitor replies to clients too, so it must be stopped before they are removed
+        delete fs_monitor;
+        std::cout << CAPIO_LOG_SERVER_CLI_LEVEL_WARNING << " [ " << node_name << " ] "
+                  << "fs_monitor cleanup completed" << std::endl;
+        print_lane_stats("Blocking", blocking_stats);
+        print_lane_stats("Notification", notification_stats);
+        std::cout << CAPIO_SERVER_CLI_LOG_SERVER << " [ " << node_name << " ] "
+                  << "Blocking requests delayed by notifications of their caller: "
+                  << fenced_requests << std::endl;
+        std::cout << CAPIO_SERVER_CLI_LOG_SERVER << " [ " << node_name << " ] "
+                  << "Write notifications merged into a later one: "
+                  << request_stats.coalesced_writes()
+                  << std::endl;
         delete buf_requests;
 
         std::cout << CAPIO_LOG_SERVER_CLI_LEVEL_WARNING << " [ " << node_name << " ] "
                   << "buf_requests cleanup completed" << std::endl;
+
+        delete client_manager;
+    }
+
+    // Whether a blocking request is waiting on any shard
+    [[nodiscard]] inline bool blocking_pending() const {
+        for (int shard = 0; shard < buf_requests->size(); ++shard) {
+            if (buf_requests->lane(shard, CAPIO_REQUEST_LANE_BLOCKING)->available() > 0) {
+                return true;
+            }
+        }
+        return false;
     }
 
+    /**
+     * Serve requests forever, in passes over all the shards. Each pass handles up to
+     * CAPIO_REQ_PRIORITY_BURST blocking requests per shard, then up to
+     * CAPIO_REQ_NOTIFICATION_QUANTUM notifications per shard, starting from a different shard
+     * every time. A pending blocking request ends the pass early, but only after the first
+     * notification, so that notifications make progress under any load. The writes held back
+     * during the pass are handled at its end
+     */
     [[noreturn]] void start() {
         START_LOG(gettid(), "call()");
 
-        auto str = std::unique_ptr<char[]>(new char[CAPIO_REQ_MAX_SIZE]);
+        const int nr_shards = buf_requests->size();
+        int first_shard     = 0;
         while (true) {
-            LOG(CAPIO_LOG_SERVER_REQUEST_START);
-            int code = read_next_request(str.get());
-            if (code < 0 || code > CAPIO_NR_REQUESTS) {
-                std::cout << CAPIO_LOG_SERVER_CLI_LEVEL_ERROR << " [ " << node_name << " ] "
-                          << "Received invalid code: " << code << std::endl;
+            long int handled = 0;
+            for (int shard = 0; shard < nr_shards; ++shard) {
+                long int count = std::min(
+                    buf_requests->lane(shard, CAPIO_REQUEST_LANE_BLOCKING)->available(),
+                    static_cast<long int>(CAPIO_REQ_PRIORITY_BURST));
+                for (; count > 0; --count, ++handled) {
+                    handle_next_request(shard, CAPIO_REQUEST_LANE_BLOCKING);
+                }
+            }
+
+            bool preempted = false;
+            for (int i = 0; i < nr_shards && !preempted; ++i) {
+                const int shard = (first_shard + i) % nr_shards;
+                long int count  = std::min(
+                    buf_requests->lane(shard, CAPIO_REQUEST_LANE_NOTIFICATION)->available(),
+                    static_cast<long int>(CAPIO_REQ_NOTIFICATION_QUANTUM));
+                for (; count > 0 && !preempted; --count, ++handled) {
+                    handle_next_request(shard, CAPIO_REQUEST_LANE_NOTIFICATION);
+                    preempted = blocking_pending();
+                }
+            }
+            first_shard = (first_shard + 1) % nr_shards;
+            flush_writes();
 
-                ERR_EXIT("Error: received invalid request code");
+            if (handled == 0) {
+                // nothing left on any lane: park until a producer rings the doorbell
+                buf_requests->wait_requests();
             }
-            request_handlers[code](str.get());
-            LOG(CAPIO_LOG_SERVER_REQUEST_END);
         }
     }
 };
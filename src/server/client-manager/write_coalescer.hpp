@@ -0,0 +1,92 @@
+#ifndef CAPIO_WRITE_COALESCER_HPP
+#define CAPIO_WRITE_COALESCER_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "capio/requests.hpp"
+
+/**
+ * Write notifications held back by the dispatcher until the end of a pass. The notifications of a
+ * thread on the same file descriptor and path are merged into the last one, which then carries
+ * the bytes written by all of them. Buffers are reused from a pass to the next, so holding a
+ * notification does not allocate once the dispatcher has warmed up
+ */
+class WriteCoalescer {
+    struct PendingWrite {
+        pid_t tid;
+        int fd;
+        std::string path;
+        capio_off64_t write_size; // bytes written by all the notifications merged
+        std::vector<char> payload;
+    };
+
+    std::vector<PendingWrite> _pending;
+    std::size_t _nr_pending = 0;
+
+    // Store the request of @param size bytes in @param buf into @param pending, with its write size
+    static inline void _store(PendingWrite &pending, const char *buf, long int size) {
+        pending.payload.assign(buf, buf + size);
+        memcpy(pending.payload.data() + offsetof(WriteRequest, write_size), &pending.write_size,
+               sizeof(pending.write_size));
+    }
+
+  public:
+    /**
+     * Hold back the write notification @param request, of @param size bytes stored in @param buf,
+     * or merge it into the one held back for the same thread, file descriptor and path
+     * @param request
+     * @param buf
+     * @param size
+     * @return whether the notification was merged into another one
+     */
+    inline bool hold(const CapioRequestView<WriteRequest> &request, const char *buf,
+                     long int size) {
+        START_LOG(gettid(), "call(tid=%d, fd=%d, path=%s)", request->header.tid, request->fd,
+                  request.str[0]);
+        const std::string_view path = request.str[0];
+        for (std::size_t i = 0; i < _nr_pending; ++i) {
+            auto &pending = _pending[i];
+            if (pending.tid == request->header.tid && pending.fd == request->fd &&
+                pending.path == path) {
+                LOG("Merging write of %llu bytes", request->write_size);
+                pending.write_size += request->write_size;
+                _store(pending, buf, size);
+                return true;
+            }
+        }
+        if (_nr_pending == _pending.size()) {
+            _pending.emplace_back();
+        }
+        auto &pending      = _pending[_nr_pending++];
+        pending.tid        = request->header.tid;
+        pending.fd         = request->fd;
+        pending.write_size = request->write_size;
+        pending.path.assign(path);
+        _store(pending, buf, size);
+        return false;
+    }
+
+    /**
+     * Pass the notifications held back to @param handler, in the order they were first received,
+     * and forget them
+     * @tparam Handler callable taking a CapioRequestHeader, a const char * and a long int
+     * @param handler
+     */
+    template <class Handler> inline void flush(Handler &&handler) {
+        for (std::size_t i = 0; i < _nr_pending; ++i) {
+            const auto &payload = _pending[i].payload;
+            CapioRequestHeader header{};
+            memcpy(&header, payload.data(), sizeof(CapioRequestHeader));
+            handler(header, payload.data(), static_cast<long int>(payload.size()));
+        }
+        _nr_pending = 0;
+    }
+
+    // Number of notifications held back
+    [[nodiscard]] inline std::size_t size() const { return _nr_pending; }
+};
+
+#endif // CAPIO_WRITE_COALESCER_HPP
@@ -5,31 +5,54 @@ class CapioCTLModule {
 
     std::thread *th;
 
-    bool *continue_execution = new bool;
-    CSBufRequest_t *readQueue;
-    CSBufRequest_t *writeQueue;
+    std::atomic<bool> *continue_execution = new std::atomic<bool>;
+    CircularBuffer<char> *readQueue;
+    CircularBuffer<char> *writeQueue;
 
-    static void _main(const bool *continue_execution, CSBufRequest_t *readQueue,
-                      CSBufRequest_t *writeQueue) {
+    static void _main(const std::atomic<bool> *continue_execution,
+                      CircularBuffer<char> *readQueue, CircularBuffer<char> *writeQueue) {
+        block_termination_signals();
         START_LOG(gettid(), "INFO: instance of CapioCTLModule");
 
-        char request[CAPIO_REQ_MAX_SIZE];
+        char request[CAPIO_CTL_MSG_MAX_SIZE];
 
-        while (*continue_execution) {
+        while (true) {
             LOG("Reading incoming request");
             readQueue->read(request);
+            if (!*continue_execution) {
+                LOG("Stopping CapioCTLModule");
+                break;
+            }
+            request[CAPIO_CTL_MSG_MAX_SIZE - 1] = '\0';
             LOG("Received request %s", request);
+            if (strcmp(request, CAPIO_CTL_REQUEST_STATS) == 0) {
+                request_stats.print([writeQueue](const char *line) { _reply(writeQueue, line); });
+            } else {
+                char line[CAPIO_CTL_MSG_MAX_SIZE];
+                snprintf(line, sizeof(line), "Unsupported request: %.200s", request);
+                _reply(writeQueue, line);
+            }
+            // an empty line ends the reply
+            _reply(writeQueue, "");
             /*
              * TODO: implement logic of CAPIO-CTL
              */
         }
     }
 
+    // Send @param line to capioctl as one message
+    static void _reply(CircularBuffer<char> *writeQueue, const char *line) {
+        char msg[CAPIO_CTL_MSG_MAX_SIZE]{};
+        snprintf(msg, sizeof(msg), "%s", line);
+        writeQueue->write(msg);
+    }
+
   public:
     CapioCTLModule() {
-        readQueue = new CSBufRequest_t("RX", CAPIO_REQ_BUFF_CNT, CAPIO_REQ_MAX_SIZE, workflow_name);
-        writeQueue =
-            new CSBufRequest_t("TX", CAPIO_REQ_BUFF_CNT, CAPIO_REQ_MAX_SIZE, workflow_name);
+        readQueue  = new CircularBuffer<char>("RX", CAPIO_REQ_BUFF_CNT, CAPIO_CTL_MSG_MAX_SIZE,
+                                              workflow_name);
+        writeQueue = new CircularBuffer<char>("TX", CAPIO_REQ_BUFF_CNT, CAPIO_CTL_MSG_MAX_SIZE,
+                                              workflow_name);
 
         *continue_execution = true;
         th                  = new std::thread(_main, continue_execution, readQueue, writeQueue);
@@ -38,8 +61,10 @@ class CapioCTLModule {
     }
 
     ~CapioCTLModule() {
+        // wake up the thread waiting for a request, so that it sees the stop flag
+        char stop[CAPIO_CTL_MSG_MAX_SIZE]{};
         *continue_execution = false;
-        pthread_cancel(th->native_handle());
+        readQueue->write(stop);
         th->join();
         delete continue_execution;
         delete readQueue;
@@ -0,0 +1,193 @@
+#ifndef CAPIO_COMMIT_STORE_HPP
+#define CAPIO_COMMIT_STORE_HPP
+
+#include <filesystem>
+#include <mutex>
+#include <shared_mutex>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+/**
+ * Commit tokens and close counts of files, kept in a single file of the metadata directory shared
+ * by every server. The file is an open addressing hash table of fixed size, whose slots are never
+ * released once claimed. Slots are only accessed with pread and pwrite while holding a fcntl
+ * record lock on them, so that servers on different nodes do not rely on shared mappings of the
+ * file. Paths are identified by two independent 64 bit hashes instead of being stored.
+ */
+class CommitStore {
+    struct Header {
+        unsigned int magic;
+        unsigned int version;
+        unsigned long long slots; // power of two
+        char padding[48];
+    };
+
+    struct Slot {
+        unsigned long long key;   // first hash of the path, 0 if the slot is free
+        unsigned long long check; // second hash of the path
+        long long close_count;
+        unsigned int token; // whether the file has been committed by a producer
+        unsigned int reserved;
+    };
+
+    static_assert(sizeof(Header) == 64 && sizeof(Slot) == 32, "commit store layout changed");
+
+    int _fd;
+    unsigned long long _mask;
+    // record locks are owned by the descriptor, so they do not exclude the threads of the server
+    mutable std::shared_mutex _mutex;
+
+    static off_t _offset(unsigned long long index) {
+        return sizeof(Header) + index * sizeof(Slot);
+    }
+
+    void _lock(off_t start, off_t len, short type) const {
+        START_LOG(gettid(), "call(start=%ld, len=%ld, type=%d)", start, len, type);
+        struct flock lock {};
+        lock.l_type   = type;
+        lock.l_whence = SEEK_SET;
+        lock.l_start  = start;
+        lock.l_len    = len;
+        while (fcntl(_fd, F_OFD_SETLKW, &lock) == -1) {
+            if (errno != EINTR) {
+                ERR_EXIT("Unable to lock commit store: %s", strerror(errno));
+            }
+        }
+    }
+
+    void _read(unsigned long long index, Slot *slot) const {
+        START_LOG(gettid(), "call(index=%llu)", index);
+        if (pread(_fd, slot, sizeof(Slot), _offset(index)) != sizeof(Slot)) {
+            ERR_EXIT("Unable to read slot %llu of commit store: %s", index, strerror(errno));
+        }
+    }
+
+    void _write(unsigned long long index, const Slot &slot) const {
+        START_LOG(gettid(), "call(index=%llu)", index);
+        if (pwrite(_fd, &slot, sizeof(Slot), _offset(index)) != sizeof(Slot)) {
+            ERR_EXIT("Unable to write slot %llu of commit store: %s", index, strerror(errno));
+        }
+    }
+
+    /**
+     * Find the slot of @param path, lock it with a record lock of @param type and copy it into
+     * @param slot. If @param type is F_WRLCK and the path has no slot, the first free one is
+     * claimed: it is written only by the caller, together with its update
+     * @return the index of the slot, to be unlocked by the caller, or -1 if the path has none
+     */
+    long long _lock_slot(const std::string &path, short type, Slot *slot) const {
+        START_LOG(gettid(), "call(path=%s, type=%d)", path.c_str(), type);
+        const unsigned long long key   = capio_path_hash(path, 0xcbf29ce484222325ULL);
+        const unsigned long long check = capio_path_hash(path, 0x9e3779b97f4a7c15ULL);
+        for (unsigned long long i = 0; i <= _mask; ++i) {
+            const unsigned long long index = (key + i) & _mask;
+            _lock(_offset(index), sizeof(Slot), type);
+            _read(index, slot);
+            if (slot->key == 0 && type == F_WRLCK) {
+                LOG("Claiming slot %llu", index);
+                slot->key   = key;
+                slot->check = check;
+            }
+            if (slot->key == key && slot->check == check) {
+                return static_cast<long long>(index);
+            }
+            _lock(_offset(index), sizeof(Slot), F_UNLCK);
+            if (slot->key == 0) {
+                return -1;
+            }
+        }
+        if (type == F_WRLCK) {
+            ERR_EXIT("Commit store is full: raise CAPIO_COMMIT_STORE_SLOTS and remove %s",
+                     CAPIO_COMMIT_STORE_NAME);
+        }
+        return -1;
+    }
+
+    // Apply @param update to the slot of @param path, claiming one if it has none
+    template <class Update> void _update(const std::string &path, Update update) const {
+        START_LOG(gettid(), "call(path=%s)", path.c_str());
+        std::unique_lock<std::shared_mutex> lg(_mutex);
+        Slot slot{};
+        const long long index = _lock_slot(path, F_WRLCK, &slot);
+        update(slot);
+        _write(index, slot);
+        _lock(_offset(index), sizeof(Slot), F_UNLCK);
+    }
+
+    // Copy the slot of @param path into @param slot, or return false if the path has none
+    bool _get(const std::string &path, Slot *slot) const {
+        START_LOG(gettid(), "call(path=%s)", path.c_str());
+        std::shared_lock<std::shared_mutex> lg(_mutex);
+        const long long index = _lock_slot(path, F_RDLCK, slot);
+        if (index < 0) {
+            return false;
+        }
+        _lock(_offset(index), sizeof(Slot), F_UNLCK);
+        return true;
+    }
+
+  public:
+    explicit CommitStore(const std::filesystem::path &path) {
+        START_LOG(gettid(), "call(path=%s)", path.c_str());
+        _fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0664);
+        if (_fd == -1) {
+            ERR_EXIT("Unable to open commit store %s: %s", path.c_str(), strerror(errno));
+        }
+
+        // the first server to lock the header initializes the store
+        Header header{};
+        _lock(0, sizeof(Header), F_WRLCK);
+        struct stat st {};
+        if (fstat(_fd, &st) == -1) {
+            ERR_EXIT("Unable to stat commit store %s", path.c_str());
+        }
+        if (st.st_size == 0) {
+            header.magic   = CAPIO_COMMIT_STORE_MAGIC;
+            header.version = CAPIO_COMMIT_STORE_VERSION;
+            header.slots   = get_capio_commit_store_slots();
+            LOG("Creating commit store with %llu slots", header.slots);
+            if (ftruncate(_fd, sizeof(Header) + header.slots * sizeof(Slot)) == -1 ||
+                pwrite(_fd, &header, sizeof(Header), 0) != sizeof(Header)) {
+                ERR_EXIT("Unable to create commit store %s: %s", path.c_str(), strerror(errno));
+            }
+        } else if (pread(_fd, &header, sizeof(Header), 0) != sizeof(Header) ||
+                   header.magic != CAPIO_COMMIT_STORE_MAGIC ||
+                   header.version != CAPIO_COMMIT_STORE_VERSION) {
+            ERR_EXIT("%s is not a commit store of this CAPIO version", path.c_str());
+        }
+        _lock(0, sizeof(Header), F_UNLCK);
+
+        _mask = header.slots - 1;
+
+        std::cout << CAPIO_SERVER_CLI_LOG_SERVER << " [ " << node_name << " ] "
+                  << "CommitStore initialization completed (" << header.slots << " slots)."
+                  << std::endl;
+    }
+
+    CommitStore(const CommitStore &)            = delete;
+    CommitStore &operator=(const CommitStore &) = delete;
+    ~CommitStore() { close(_fd); }
+
+    // Record that a producer committed @param path
+    inline void setToken(const std::string &path) const {
+        _update(path, [](Slot &slot) { slot.token = 1; });
+    }
+
+    [[nodiscard]] inline bool hasToken(const std::string &path) const {
+        Slot slot{};
+        return _get(path, &slot) && slot.token != 0;
+    }
+
+    // Count one more close of @param path
+    inline void increaseCloseCount(const std::string &path) const {
+        _update(path, [](Slot &slot) { slot.close_count++; });
+    }
+
+    [[nodiscard]] inline long long getCloseCount(const std::string &path) const {
+        Slot slot{};
+        return _get(path, &slot) ? slot.close_count : 0;
+    }
+};
+
+#endif // CAPIO_COMMIT_STORE_HPP
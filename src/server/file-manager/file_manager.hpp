@@ -1,23 +1,68 @@
 #ifndef FILE_MANAGER_HEADER_HPP
 #define FILE_MANAGER_HEADER_HPP
 
+#include <algorithm>
+#include <chrono>
 #include <mutex>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "commit_store.hpp"
+
 std::mutex threads_mutex;
 std::mutex data_mutex;
+std::mutex states_mutex;
+
+/**
+ * What the server knows about a path from the requests of its clients and from what it has already
+ * seen on the file system. Only facts that cannot be undone are recorded: a path that exists, a
+ * file that is committed. Commit tokens and close counts are kept by the CommitStore.
+ * Directories also count their entries, by scanning them and then by adding the paths that
+ * become known to exist inside them
+ */
+struct CapioFileState {
+    std::filesystem::file_type type = std::filesystem::file_type::none; // none if not known yet
+
+    uintmax_t size = 0; // largest size seen on the file system
+    bool exists    = false;
+    bool committed = false;
+
+    long entries = -1; // entries of a directory, -1 if it has never been scanned
+    std::chrono::steady_clock::time_point scanned_at;
+};
+
+// Threads waiting for data of a file, as a min-heap of the offsets they wait for and their tid
+typedef std::vector<std::pair<capio_off64_t, pid_t>> CapioDataWaiters;
+
+// Conditions a thread can wait for on a path
+enum CapioWaitCondition {
+    CAPIO_WAIT_CREATION, // the path exists
+    CAPIO_WAIT_DATA,     // the file holds the offset waited for, and is committed or firable
+};
 
 class CapioFileManager {
     std::unordered_map<std::string, std::vector<pid_t> *> *thread_awaiting_file_creation;
-    std::unordered_map<std::string, std::unordered_map<pid_t, capio_off64_t> *>
-        *thread_awaiting_data;
+    std::unordered_map<std::string, CapioDataWaiters *> *thread_awaiting_data;
+    std::unordered_map<std::string, CapioFileState> *file_states;
+    CommitStore *commit_store;
 
-    static std::string getAndCreateMetadataPath(const std::string &path);
+    void recordExists(const std::string &path, CapioFileState &state) const;
+    void forgetState(const std::string &path) const;
+    long countEntries(const std::string &path, bool rescan, bool *scanned) const;
+    bool computeCommitted(const std::string &path) const;
+    void addThreadAwaitingCreation(const std::string &path, pid_t tid) const;
+    void unlockThreadAwaitingCreation(const std::string &path) const;
+    void addThreadAwaitingData(const std::string &path, pid_t tid, capio_off64_t offset) const;
+    void checkAndUnlockThreadAwaitingData(const std::string &path) const;
 
   public:
     CapioFileManager() {
         START_LOG(gettid(), "call()");
         thread_awaiting_file_creation = new std::unordered_map<std::string, std::vector<pid_t> *>;
-        thread_awaiting_data =
-            new std::unordered_map<std::string, std::unordered_map<pid_t, capio_off64_t> *>;
+        thread_awaiting_data = new std::unordered_map<std::string, CapioDataWaiters *>;
+        file_states  = new std::unordered_map<std::string, CapioFileState>;
+        commit_store = new CommitStore(get_capio_metadata_path() / CAPIO_COMMIT_STORE_NAME);
         std::cout << CAPIO_SERVER_CLI_LOG_SERVER << " [ " << node_name << " ] "
                   << "CapioFileManager initialization completed." << std::endl;
     }
@@ -25,18 +70,30 @@ class CapioFileManager {
         START_LOG(gettid(), "call()");
         delete thread_awaiting_file_creation;
         delete thread_awaiting_data;
+        delete file_states;
+        delete commit_store;
     }
 
-    static uintmax_t get_file_size_if_exists(const std::filesystem::path &path);
-    static void increaseCloseCount(const std::filesystem::path &path);
-    static bool isCommitted(const std::filesystem::path &path);
-    void setCommitted(const std::filesystem::path &path) const;
+    // whether @param path has a commit token, and how many times it has been closed
+    [[nodiscard]] std::pair<bool, long long> getCommitState(const std::string &path) const;
+    void setCreated(const std::string &path) const;
+    void setExists(const std::string &path) const;
+    void setRemoved(const std::string &path) const;
+    void renameState(const std::string &old_path, const std::string &new_path) const;
+    [[nodiscard]] bool exists(const std::string &path) const;
+    [[nodiscard]] bool isDirectory(const std::string &path) const;
+    uintmax_t get_file_size_if_exists(const std::string &path) const;
+    uintmax_t getFileSize(const std::string &path, uintmax_t min_size) const;
+    void increaseCloseCount(const std::string &path) const;
+    [[nodiscard]] bool isCommitted(const std::string &path) const;
+    void setCommitted(const std::string &path) const;
     void setCommitted(pid_t tid) const;
-    void checkAndUnlockThreadAwaitingData(const std::string &path) const;
-    void addThreadAwaitingData(std::string path, int tid, size_t expected_size) const;
-    void unlockThreadAwaitingCreation(std::string path) const;
-    void addThreadAwaitingCreation(std::string path, pid_t tid) const;
-    void deleteFileAwaitingCreation(std::string path) const;
+    void await(CapioWaitCondition condition, const std::string &path, pid_t tid,
+               capio_off64_t offset = 0) const;
+    void fileChanged(const std::string &path) const;
+    [[nodiscard]] bool fileCreated(const std::string &path) const;
+    [[nodiscard]] bool hasThreadAwaitingData(const std::string &path) const;
+    void unlockProducersAwaitingData(const std::string &path) const;
     [[nodiscard]] std::vector<std::string> getFileAwaitingCreation() const;
     [[nodiscard]] std::vector<std::string> getFileAwaitingData() const;
 };
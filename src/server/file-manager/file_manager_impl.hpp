@@ -3,153 +3,403 @@
 #include "capio/env.hpp"
 #include "client-manager/client_manager.hpp"
 #include "file_manager.hpp"
-#include "utils/distributed_semaphore.hpp"
 
-inline std::string CapioFileManager::getAndCreateMetadataPath(const std::string &path) {
+inline std::pair<bool, long long>
+CapioFileManager::getCommitState(const std::string &path) const {
+    return {commit_store->hasToken(path), commit_store->getCloseCount(path)};
+}
+
+/*
+ * Record in state that path exists. The first time, path is counted among the entries of its
+ * directory, if they have been counted. Must be called holding states_mutex
+ */
+inline void CapioFileManager::recordExists(const std::string &path, CapioFileState &state) const {
+    if (state.exists) {
+        return;
+    }
+    state.exists = true;
+    const std::filesystem::path fs_path(path);
+    if (fs_path.extension() == ".capio") {
+        return;
+    }
+    auto parent = file_states->find(fs_path.parent_path());
+    if (parent != file_states->end() && parent->second.entries >= 0) {
+        parent->second.entries++;
+    }
+}
+
+/*
+ * Forget what is known of path, and of the files under it unless it is known to be a regular file.
+ * If path exists, it is no longer counted among the entries of its directory. Must be called
+ * holding states_mutex
+ */
+inline void CapioFileManager::forgetState(const std::string &path) const {
+    auto it = file_states->find(path);
+    if (it == file_states->end()) {
+        return;
+    }
+    const bool regular = it->second.type == std::filesystem::file_type::regular;
+    if (it->second.exists && std::filesystem::path(path).extension() != ".capio") {
+        auto parent = file_states->find(std::filesystem::path(path).parent_path());
+        if (parent != file_states->end() && parent->second.entries > 0) {
+            parent->second.entries--;
+        }
+    }
+    file_states->erase(it);
+    if (regular) {
+        return;
+    }
+    const std::string prefix = path + "/";
+    for (auto child = file_states->begin(); child != file_states->end();) {
+        child = child->first.compare(0, prefix.size(), prefix) == 0 ? file_states->erase(child)
+                                                                    : std::next(child);
+    }
+}
+
+// record that a client of this node created path, which is empty until it is written
+inline void CapioFileManager::setCreated(const std::string &path) const {
     START_LOG(gettid(), "call(path=%s)", path.c_str());
-    std::filesystem::path result =
-        get_capio_metadata_path() / (path.substr(path.find(get_capio_dir()) + 1) + ".capio");
+    std::lock_guard<std::mutex> lg(states_mutex);
+    auto &state        = (*file_states)[path];
+    const bool existed = state.exists;
+    state              = CapioFileState{};
+    state.type         = std::filesystem::file_type::regular;
+    state.exists       = existed; // already counted among the entries of its directory
+    recordExists(path, state);
+}
 
-    LOG("metadata path is %s", result.c_str());
-    LOG("Creating metadata directory (%s)", result.parent_path().c_str());
-    std::filesystem::create_directories(result.parent_path());
+// record that path has been found on the file system
+inline void CapioFileManager::setExists(const std::string &path) const {
+    START_LOG(gettid(), "call(path=%s)", path.c_str());
+    std::lock_guard<std::mutex> lg(states_mutex);
+    recordExists(path, (*file_states)[path]);
+}
 
-    LOG("Created capio metadata parent path (if no file existed). returning metadata token file");
-    return result;
+// record that path has been removed from the file system
+inline void CapioFileManager::setRemoved(const std::string &path) const {
+    START_LOG(gettid(), "call(path=%s)", path.c_str());
+    std::lock_guard<std::mutex> lg(states_mutex);
+    forgetState(path);
 }
 
-inline uintmax_t CapioFileManager::get_file_size_if_exists(const std::filesystem::path &path) {
-    if (std::filesystem::exists(path)) {
-        return std::filesystem::file_size(path);
+/*
+ * Move the state of old_path to new_path. Only its type, size and entries are kept, while whether
+ * it is committed is computed again for new_path. The files under old_path are forgotten
+ */
+inline void CapioFileManager::renameState(const std::string &old_path,
+                                          const std::string &new_path) const {
+    START_LOG(gettid(), "call(old_path=%s, new_path=%s)", old_path.c_str(), new_path.c_str());
+    std::lock_guard<std::mutex> lg(states_mutex);
+    auto it = file_states->find(old_path);
+    if (it == file_states->end() || !it->second.exists) {
+        forgetState(old_path);
+        forgetState(new_path);
+        return;
     }
-    return 0;
+    CapioFileState state = it->second;
+    forgetState(old_path);
+    forgetState(new_path);
+    state.exists    = false;
+    state.committed = false;
+    // counted again in the directory of new_path
+    auto &moved = (*file_states)[new_path];
+    moved       = state;
+    recordExists(new_path, moved);
 }
 
-inline void CapioFileManager::addThreadAwaitingCreation(std::string path, pid_t tid) const {
-    START_LOG(gettid(), "call(path=%s, tid=%ld)", path.c_str(), tid);
-    std::lock_guard<std::mutex> lg(threads_mutex);
-    thread_awaiting_file_creation->try_emplace(path, new std::vector<int>);
-    thread_awaiting_file_creation->at(path)->emplace_back(tid);
+inline bool CapioFileManager::exists(const std::string &path) const {
+    {
+        std::lock_guard<std::mutex> lg(states_mutex);
+        auto it = file_states->find(path);
+        if (it != file_states->end() && it->second.exists) {
+            return true;
+        }
+    }
+    if (access(path.c_str(), F_OK) != 0) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lg(states_mutex);
+    recordExists(path, (*file_states)[path]);
+    return true;
 }
 
-inline void CapioFileManager::unlockThreadAwaitingCreation(std::string path) const {
+inline bool CapioFileManager::isDirectory(const std::string &path) const {
+    {
+        std::lock_guard<std::mutex> lg(states_mutex);
+        auto it = file_states->find(path);
+        if (it != file_states->end() && it->second.type != std::filesystem::file_type::none) {
+            return it->second.type == std::filesystem::file_type::directory;
+        }
+    }
+    struct stat st {};
+    if (stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+    const auto type = S_ISDIR(st.st_mode)   ? std::filesystem::file_type::directory
+                      : S_ISREG(st.st_mode) ? std::filesystem::file_type::regular
+                                            : std::filesystem::file_type::unknown;
+    std::lock_guard<std::mutex> lg(states_mutex);
+    auto &state = (*file_states)[path];
+    state.type  = type;
+    recordExists(path, state);
+    return type == std::filesystem::file_type::directory;
+}
+
+inline uintmax_t CapioFileManager::get_file_size_if_exists(const std::string &path) const {
+    struct stat st {};
+    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+        return 0;
+    }
+    const uintmax_t size = st.st_size;
+    std::lock_guard<std::mutex> lg(states_mutex);
+    auto &state = (*file_states)[path];
+    state.size  = std::max(state.size, size);
+    recordExists(path, state);
+    return size;
+}
+
+// size of path, taken from the state table if it is already known to be at least min_size bytes
+inline uintmax_t CapioFileManager::getFileSize(const std::string &path, uintmax_t min_size) const {
+    {
+        std::lock_guard<std::mutex> lg(states_mutex);
+        auto it = file_states->find(path);
+        if (it != file_states->end() && min_size > 0 && it->second.size >= min_size) {
+            return it->second.size;
+        }
+    }
+    return get_file_size_if_exists(path);
+}
+
+/**
+ * Make thread @param tid wait until @param condition holds on @param path, after a probe found it
+ * does not hold yet. The thread is resumed by fileChanged, which is the only place where waiting
+ * threads are woken up. As the path may have changed after it was probed, the condition is
+ * evaluated again once the thread is registered
+ * @param condition
+ * @param path
+ * @param tid
+ * @param offset for CAPIO_WAIT_DATA, the offset the thread waits for
+ */
+inline void CapioFileManager::await(CapioWaitCondition condition, const std::string &path,
+                                    pid_t tid, capio_off64_t offset) const {
+    START_LOG(gettid(), "call(condition=%d, path=%s, tid=%ld, offset=%llu)", condition,
+              path.c_str(), tid, offset);
+    request_stats.parked();
+    switch (condition) {
+    case CAPIO_WAIT_CREATION:
+        addThreadAwaitingCreation(path, tid);
+        break;
+    case CAPIO_WAIT_DATA:
+        addThreadAwaitingData(path, tid, offset);
+        break;
+    }
+    if (exists(path)) {
+        fileChanged(path);
+    }
+}
+
+/**
+ * Resume the threads whose wait on @param path, or on the directory holding it, may be over now
+ * that the path exists and has changed. Called on every change the server learns of, either from
+ * its clients or from the file system
+ * @param path
+ */
+inline void CapioFileManager::fileChanged(const std::string &path) const {
     START_LOG(gettid(), "call(path=%s)", path.c_str());
-    std::lock_guard<std::mutex> lg(threads_mutex);
-    if (thread_awaiting_file_creation->find(path) != thread_awaiting_file_creation->end()) {
-        auto th = thread_awaiting_file_creation->at(path);
-        for (auto tid : *th) {
-            client_manager->reply_to_client(tid, 1);
+    unlockThreadAwaitingCreation(path);
+    checkAndUnlockThreadAwaitingData(path);
+    // directories are committed once they hold enough files
+    checkAndUnlockThreadAwaitingData(std::filesystem::path(path).parent_path());
+}
+
+/**
+ * Resume the threads waiting for the creation of @param path, which does not touch the file
+ * system, as the dispatch workers do
+ * @param path
+ * @return whether threads wait for data of the path or of its directory, in which case
+ * fileChanged must be called on a probe worker
+ */
+inline bool CapioFileManager::fileCreated(const std::string &path) const {
+    START_LOG(gettid(), "call(path=%s)", path.c_str());
+    unlockThreadAwaitingCreation(path);
+    return hasThreadAwaitingData(path) ||
+           hasThreadAwaitingData(std::filesystem::path(path).parent_path());
+}
+
+inline void CapioFileManager::addThreadAwaitingCreation(const std::string &path, pid_t tid) const {
+    START_LOG(gettid(), "call(path=%s, tid=%ld)", path.c_str(), tid);
+    {
+        std::lock_guard<std::mutex> lg(threads_mutex);
+        auto [it, inserted] = thread_awaiting_file_creation->try_emplace(path, nullptr);
+        if (inserted) {
+            it->second = new std::vector<pid_t>;
         }
+        it->second->emplace_back(tid);
+        client_manager->wait_on_board(tid, path, CAPIO_WAKE_CREATION, inserted);
     }
-    thread_awaiting_file_creation->erase(path);
+    fs_monitor->watch(path);
 }
 
-inline void CapioFileManager::deleteFileAwaitingCreation(std::string path) const {
+// Threads waiting on the wake board are woken up by a single broadcast, the others one by one
+inline void CapioFileManager::unlockThreadAwaitingCreation(const std::string &path) const {
     START_LOG(gettid(), "call(path=%s)", path.c_str());
     std::lock_guard<std::mutex> lg(threads_mutex);
-    thread_awaiting_file_creation->erase(path);
+    auto it = thread_awaiting_file_creation->find(path);
+    if (it == thread_awaiting_file_creation->end()) {
+        return;
+    }
+    auto threads   = it->second;
+    const int slot = client_manager->board_slot(path, CAPIO_WAKE_CREATION);
+    request_stats.woken(threads->size());
+    if (slot != -1) {
+        client_manager->broadcast(slot, 1, threads->size());
+    } else {
+        for (auto tid : *threads) {
+            client_manager->reply_to_client(tid, 1);
+        }
+    }
+    delete threads;
+    thread_awaiting_file_creation->erase(it);
 }
 
 // register tid to wait for file size of certain size
-inline void CapioFileManager::addThreadAwaitingData(std::string path, int tid,
-                                                    size_t expected_size) const {
-    START_LOG(gettid(), "call(path=%s, tid=%ld, expected_size=%ld)", path.c_str(), tid,
-              expected_size);
+inline void CapioFileManager::addThreadAwaitingData(const std::string &path, pid_t tid,
+                                                    capio_off64_t offset) const {
+    START_LOG(gettid(), "call(path=%s, tid=%ld, offset=%llu)", path.c_str(), tid, offset);
+    {
+        std::lock_guard<std::mutex> lg(data_mutex);
+        auto [it, inserted] = thread_awaiting_data->try_emplace(path, nullptr);
+        if (inserted) {
+            it->second = new CapioDataWaiters;
+        }
+        it->second->emplace_back(offset, tid);
+        std::push_heap(it->second->begin(), it->second->end(), std::greater<>());
+        client_manager->wait_on_board(tid, path, CAPIO_WAKE_DATA, inserted);
+    }
+    fs_monitor->watch(path);
+}
+
+// whether some thread waits for data of path, without touching the file system
+inline bool CapioFileManager::hasThreadAwaitingData(const std::string &path) const {
     std::lock_guard<std::mutex> lg(data_mutex);
-    thread_awaiting_data->try_emplace(path, new std::unordered_map<pid_t, capio_off64_t>);
-    thread_awaiting_data->at(path)->emplace(tid, expected_size);
+    return thread_awaiting_data->find(path) != thread_awaiting_data->end();
 }
 
-// TODO:
+/*
+ * Wake up the threads waiting for data of path that is now available. The state of the file is
+ * evaluated once, without holding data_mutex, and as waiters are ordered by offset only the ones
+ * that are woken up are visited. Threads registered after the evaluation evaluate it again
+ * themselves. Threads waiting on the wake board are woken up by a single broadcast, the others
+ * one by one
+ */
 inline void CapioFileManager::checkAndUnlockThreadAwaitingData(const std::string &path) const {
     START_LOG(gettid(), "call(path=%s)", path.c_str());
-    LOG("Before lockguard");
-    std::lock_guard<std::mutex> lg(data_mutex);
-    LOG("Acquired lockguard");
-    if (thread_awaiting_data->find(path) != thread_awaiting_data->end()) {
-        LOG("Path has thread awaiting");
-        auto threads = thread_awaiting_data->at(path);
-        LOG("Obtained threads");
-        for (auto item = threads->begin(); item != threads->end();) {
-            LOG("Handling thread");
-            uintmax_t filesize = -1;
-
-            filesize = std::filesystem::is_directory(path) ? -1 : get_file_size_if_exists(path);
-
-            bool committed       = isCommitted(path);
-            bool file_size_check = item->first >= filesize;
-            bool is_fnu          = capio_cl_engine->getFireRule(path) == CAPIO_FILE_MODE_NO_UPDATE;
-            bool is_producer     = capio_cl_engine->isProducer(path, item->first);
-            bool lock_condition  = committed || is_producer || (file_size_check && is_fnu);
-
-            LOG("( committed(%s) || is_producer(%s) ||  ( file_size_check(%s) && is_fnu(%s) ) )",
-                committed ? "true" : "false", is_producer ? "true" : "false",
-                file_size_check ? "true" : "false", is_fnu ? "true" : "false");
-
-            LOG("Evaluation of expression: %s", lock_condition ? "TRUE" : "FALSE");
-
-            if (lock_condition) {
-                LOG("Thread %ld can be unlocked", item->first);
-                /*
-                 * Check for file size only if it is directory, otherwise,
-                 * return the max allowed size, to allow the process to continue.
-                 * This is caused by the fact that std::filesystem::file_size is
-                 * implementation defined when invoked on directories
-                 */
-                client_manager->reply_to_client(item->first, std::filesystem::is_directory(path)
-                                                                 ? ULLONG_MAX
-                                                                 : get_file_size_if_exists(path));
-                // remove thread from map
-                LOG("Removing thread %ld from threads awaiting on data", item->first);
-                item = threads->erase(item);
-            } else {
-                LOG("Waiting threads cannot yet be unlocked");
-                ++item;
-            }
-        }
+    if (!hasThreadAwaitingData(path)) {
+        return;
+    }
+    LOG("Path has thread awaiting");
+
+    const bool committed = isCommitted(path);
+    const bool is_fnu    = capio_cl_engine->getFireRule(path) == CAPIO_FILE_MODE_NO_UPDATE;
+    LOG("committed(%s), is_fnu(%s)", committed ? "true" : "false", is_fnu ? "true" : "false");
+    if (!committed && !is_fnu) {
+        LOG("Waiting threads cannot yet be unlocked");
+        return;
+    }
 
-        LOG("Completed loops over threads vector for file!");
+    /*
+     * Check for file size only if it is directory, otherwise,
+     * return the max allowed size, to allow the process to continue.
+     * This is caused by the fact that std::filesystem::file_size is
+     * implementation defined when invoked on directories
+     */
+    const bool directory      = isDirectory(path);
+    const uintmax_t filesize  = directory ? -1 : get_file_size_if_exists(path);
+    const capio_off64_t reply = committed || directory ? ULLONG_MAX : filesize;
 
-        if (threads->empty()) {
-            LOG("There are no threads waiting for path %s. cleaning up map", path.c_str());
-            thread_awaiting_data->erase(path);
+    std::lock_guard<std::mutex> lg(data_mutex);
+    auto it = thread_awaiting_data->find(path);
+    if (it == thread_awaiting_data->end()) {
+        return;
+    }
+    auto threads      = it->second;
+    const int slot    = client_manager->board_slot(path, CAPIO_WAKE_DATA);
+    std::size_t woken = 0;
+    while (!threads->empty() && (committed || threads->front().first <= filesize)) {
+        std::pop_heap(threads->begin(), threads->end(), std::greater<>());
+        const auto [offset, tid] = threads->back();
+        threads->pop_back();
+        LOG("Thread %ld waiting for offset %llu can be unlocked", tid, offset);
+        if (slot == -1) {
+            client_manager->reply_to_client(tid, reply);
         }
-        LOG("Completed checks");
+        ++woken;
+    }
+    if (slot != -1 && woken > 0) {
+        client_manager->broadcast(slot, reply, woken);
+    }
+    request_stats.woken(woken);
+
+    if (threads->empty()) {
+        LOG("There are no threads waiting for path %s. cleaning up map", path.c_str());
+        delete threads;
+        thread_awaiting_data->erase(it);
     }
 }
 
-inline void CapioFileManager::increaseCloseCount(const std::filesystem::path &path) {
+/*
+ * Wake up the threads waiting for data of path whose application has become one of its
+ * producers, and can therefore proceed. They are replied to one by one, and kicked out of the
+ * wake board if they wait there. The file is probed before taking data_mutex
+ */
+inline void CapioFileManager::unlockProducersAwaitingData(const std::string &path) const {
     START_LOG(gettid(), "call(path=%s)", path.c_str());
-    auto metadata_path    = getAndCreateMetadataPath(path);
-    const auto lock       = new DistributedSemaphore(metadata_path + ".lock", 300);
-    long long close_count = 0;
-    LOG("Gained mutual exclusive access to token file %s", (metadata_path + ".lock").c_str());
-
-    std::fstream f(metadata_path, std::ios::in | std::ios::out);
-    LOG("Opened CAPIO metadata file %s", metadata_path.c_str());
-    f >> close_count;
-    LOG("Close count is %llu. Increasing by one", close_count);
-    close_count++;
-    f.close();
+    if (!hasThreadAwaitingData(path)) {
+        return;
+    }
+    const capio_off64_t reply = isDirectory(path) ? ULLONG_MAX : get_file_size_if_exists(path);
 
-    auto out = fopen(metadata_path.c_str(), "w");
-    fprintf(out, " %llu \n", close_count);
-    fclose(out);
+    std::lock_guard<std::mutex> lg(data_mutex);
+    auto it = thread_awaiting_data->find(path);
+    if (it == thread_awaiting_data->end()) {
+        return;
+    }
+    auto threads    = it->second;
+    const auto last = std::remove_if(threads->begin(), threads->end(), [&](const auto &item) {
+        if (!capio_cl_engine->isProducer(path, item.second)) {
+            return false;
+        }
+        LOG("Thread %ld is a producer and can be unlocked", item.second);
+        client_manager->reply_to_client(item.second, reply);
+        return true;
+    });
+    if (last == threads->end()) {
+        return;
+    }
+    request_stats.woken(threads->end() - last);
+    if (const int slot = client_manager->board_slot(path, CAPIO_WAKE_DATA); slot != -1) {
+        client_manager->kick(slot);
+    }
+    threads->erase(last, threads->end());
+    std::make_heap(threads->begin(), threads->end(), std::greater<>());
 
-    LOG("Updated close count to %llu", close_count);
+    if (threads->empty()) {
+        delete threads;
+        thread_awaiting_data->erase(it);
+    }
+}
 
-    delete lock;
+inline void CapioFileManager::increaseCloseCount(const std::string &path) const {
+    START_LOG(gettid(), "call(path=%s)", path.c_str());
+    commit_store->increaseCloseCount(path);
+    LOG("Updated close count to %lld", commit_store->getCloseCount(path));
 }
 
-inline void CapioFileManager::setCommitted(const std::filesystem::path &path) const {
+inline void CapioFileManager::setCommitted(const std::string &path) const {
     START_LOG(gettid(), "call(path=%s)", path.c_str());
-    auto metadata_path = getAndCreateMetadataPath(path);
-    LOG("Creating token %s", metadata_path.c_str());
-    auto fd = open(metadata_path.c_str(), O_CREAT | S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH, 0664);
-    LOG("Token fd = %d", fd);
-    close(fd);
-    checkAndUnlockThreadAwaitingData(path);
-    unlockThreadAwaitingCreation(path);
+    LOG("Creating token");
+    commit_store->setToken(path);
+    fileChanged(path);
 }
 
 inline void CapioFileManager::setCommitted(pid_t tid) const {
@@ -161,20 +411,85 @@ inline void CapioFileManager::setCommitted(pid_t tid) const {
     }
 }
 
-inline bool CapioFileManager::isCommitted(const std::filesystem::path &path) {
+inline bool CapioFileManager::isCommitted(const std::string &path) const {
     START_LOG(gettid(), "call(path=%s)", path.c_str());
+    {
+        std::lock_guard<std::mutex> lg(states_mutex);
+        auto it = file_states->find(path);
+        if (it != file_states->end() && it->second.committed) {
+            LOG("File is known to be committed");
+            return true;
+        }
+    }
+    const bool committed = computeCommitted(path);
+    if (committed) {
+        std::lock_guard<std::mutex> lg(states_mutex);
+        (*file_states)[path].committed = true;
+    }
+    return committed;
+}
 
-    if (std::filesystem::is_directory(path)) {
+/*
+ * Number of entries of directory path. The count kept in the state table is used, unless rescan
+ * is set, path has never been scanned, or its last scan is older than CAPIO_DIR_RESCAN_INTERVAL,
+ * which catches the entries created without the server noticing. scanned is set to whether the
+ * directory has been scanned
+ */
+inline long CapioFileManager::countEntries(const std::string &path, bool rescan,
+                                           bool *scanned) const {
+    START_LOG(gettid(), "call(path=%s, rescan=%s)", path.c_str(), rescan ? "yes" : "no");
+    const auto now = std::chrono::steady_clock::now();
+    *scanned       = false;
+    if (!rescan) {
+        std::lock_guard<std::mutex> lg(states_mutex);
+        auto it = file_states->find(path);
+        if (it != file_states->end() && it->second.entries >= 0 &&
+            now - it->second.scanned_at <
+                std::chrono::milliseconds(CAPIO_DIR_RESCAN_INTERVAL)) {
+            LOG("Directory has %ld entries", it->second.entries);
+            return it->second.entries;
+        }
+    }
+
+    LOG("Scanning directory");
+    std::vector<std::filesystem::path> entries;
+    std::error_code ec;
+    for (auto const &file : std::filesystem::directory_iterator{path, ec}) {
+        if (file.path().extension() != ".capio") {
+            entries.emplace_back(file.path());
+        }
+    }
+    std::lock_guard<std::mutex> lg(states_mutex);
+    auto &state = (*file_states)[path];
+    for (const auto &entry : entries) {
+        (*file_states)[entry].exists = true;
+    }
+    state.entries    = static_cast<long>(entries.size());
+    state.scanned_at = now;
+    *scanned         = true;
+    LOG("Directory has %ld entries", state.entries);
+    return state.entries;
+}
+
+/**
+ * Commit state of @param path, from the files in it if it is a directory, or from its commit token
+ * @param path
+ * @return whether path is committed
+ */
+inline bool CapioFileManager::computeCommitted(const std::string &path) const {
+    START_LOG(gettid(), "call(path=%s)", path.c_str());
+
+    if (isDirectory(path)) {
         // is directory
         // check for n_files inside a directory
         LOG("Path is a directory");
         auto file_count = capio_cl_engine->getDirectoryFileCount(path);
         LOG("Expected file count is %ld", file_count);
-        long count = 0;
-        for (auto const &file : std::filesystem::directory_iterator{path}) {
-            if (file.path().extension() != ".capio") {
-                ++count;
-            }
+        bool scanned;
+        long count = countEntries(path, false, &scanned);
+        if (count >= file_count && !scanned) {
+            // removed entries are not tracked, so a count that is high enough is checked by a scan
+            count = countEntries(path, true, &scanned);
         }
         bool continue_directory = count >= file_count;
 
@@ -184,17 +499,14 @@ inline bool CapioFileManager::isCommitted(const std::filesystem::path &path) {
 
     // if is file
     LOG("Path is a file");
-    std::string metadata_computed_path = getAndCreateMetadataPath(path);
-    LOG("Computed metadata file path is %s", metadata_computed_path.c_str());
-
-    std::string commit_rule = capio_cl_engine->getCommitRule(path);
+    const auto &commit_rule = capio_cl_engine->getCommitRule(path);
 
-    bool metadata_token_exists = std::filesystem::exists(metadata_computed_path);
+    bool metadata_token_exists = commit_store->hasToken(path);
 
     if (commit_rule == CAPIO_FILE_COMMITTED_ON_FILE) {
         LOG("Commit rule is on_file. Checking for file dependencies");
         bool commit_computed = true;
-        for (auto file : capio_cl_engine->get_file_deps(path)) {
+        for (const auto &file : capio_cl_engine->get_file_deps(path)) {
             commit_computed = commit_computed && isCommitted(file);
         }
 
@@ -211,14 +523,8 @@ inline bool CapioFileManager::isCommitted(const std::filesystem::path &path) {
 
         if (metadata_token_exists) {
             if (commit_count != -1) {
-                long actual_commit_count = 0;
-                LOG("Commit file exists. retrieving commit count");
-                std::ifstream in(metadata_computed_path);
-                if (in.is_open()) {
-                    LOG("Opened file");
-                    in >> actual_commit_count;
-                }
-                LOG("Obtained actual commit count: %l", actual_commit_count);
+                long long actual_commit_count = commit_store->getCloseCount(path);
+                LOG("Obtained actual commit count: %lld", actual_commit_count);
                 LOG("File %s committed", actual_commit_count >= commit_count ? "IS" : "IS NOT");
                 return actual_commit_count >= commit_count;
             }
@@ -1,67 +1,335 @@
 #ifndef CAPIO_FS_FILE_SYSTEM_MONITOR_HPP
 #define CAPIO_FS_FILE_SYSTEM_MONITOR_HPP
+#include <array>
+#include <chrono>
+#include <mutex>
 #include <thread>
 
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+
+#include "statx_ring.hpp"
+
+/**
+ * Wakes up the threads waiting for files that are created or written outside of CAPIO. The parent
+ * directories of awaited files are watched with inotify, and their events drive the checks of
+ * CapioFileManager. Events are not reported for changes made by other nodes of a parallel file
+ * system, so awaited files are also polled, every CAPIO_FS_POLL_INTERVAL milliseconds at first and
+ * then less and less often as long as polls find nothing new
+ */
 class FileSystemMonitor {
     std::thread *th;
+    int _inotify_fd, _wake_fd;
+    std::atomic<bool> _stop{false};
+    std::atomic<bool> _backed_off{false}; // whether polls are less frequent than configured
 
-    bool *continue_execution = new bool;
+    std::mutex _watch_mutex; // guards _watches
+    std::unordered_map<int, std::filesystem::path> _watches; // watched directories by descriptor
 
-  public:
-    static void _main(const bool *continue_execution) {
+    static constexpr uint32_t _mask =
+        IN_CREATE | IN_MOVED_TO | IN_CLOSE_WRITE | IN_MODIFY | IN_DELETE | IN_MOVED_FROM;
 
-        START_LOG(gettid(), "INFO: instance of FileSystemMonitor");
+    // size and modification time of a file awaited for data, then its commit token and close count
+    typedef std::array<long long, 4> Signature;
+    struct Seen {
+        Signature signature;
+        bool changed; // since the poll before
+    };
+
+    StatxRing _ring{CAPIO_FS_STATX_BATCH};
+    // buffers of _poll, kept across polls so that they are not allocated again
+    std::vector<std::string> _paths;
+    std::vector<struct statx> _results;
+    std::vector<int> _errors;
+    std::unordered_map<std::string, Seen> _seen, _last_seen;
+
+    unsigned long long _events = 0, _polls = 0, _probed = 0;
+    std::chrono::nanoseconds _poll_time{0}, _max_poll_time{0};
+
+    inline void _signature(std::size_t i, long long *dst) const {
+        if (_errors[i] != 0) {
+            dst[0] = -1;
+            dst[1] = 0;
+            return;
+        }
+        dst[0] = static_cast<long long>(_results[i].stx_size);
+        dst[1] = _results[i].stx_mtime.tv_sec * 1000000000LL + _results[i].stx_mtime.tv_nsec;
+    }
+
+    /**
+     * Get the metadata of all the awaited files in one batch. Threads waiting for the creation of
+     * a file that exists are woken up, while files that changed since the last poll, or whose
+     * commit state changed, are checked by CapioFileManager, which knows whether there is enough
+     * data. A file is checked again at the next poll, in case it changes
+     * again within the resolution of modification times.
+     * @return whether anything changed since the last poll
+     */
+    bool _poll() {
+        START_LOG(gettid(), "call()");
+        const auto start = std::chrono::steady_clock::now();
+        _polls++;
+
+        const auto creation = file_manager->getFileAwaitingCreation();
+        const auto data     = file_manager->getFileAwaitingData();
+        _paths.clear();
+        _paths.insert(_paths.end(), creation.begin(), creation.end());
+        _paths.insert(_paths.end(), data.begin(), data.end());
+        _ring.statx(_paths, _results, _errors);
+        _probed += _paths.size();
+
+        bool changed = false;
+        for (std::size_t i = 0; i < creation.size(); ++i) {
+            if (_errors[i] == 0) {
+                LOG("File %s exists. Unlocking thread awaiting for creation", creation[i].c_str());
+                file_manager->setExists(creation[i]);
+                file_manager->fileChanged(creation[i]);
+                changed = true;
+            }
+        }
+
+        for (std::size_t i = 0, item = creation.size(); i < data.size(); ++i, ++item) {
+            Seen seen{};
+            _signature(item, seen.signature.data());
+            const auto [token, close_count] = file_manager->getCommitState(data[i]);
+            seen.signature[2]               = token;
+            seen.signature[3]               = close_count;
+            const auto last = _last_seen.find(data[i]);
+            seen.changed    = last == _last_seen.end() || last->second.signature != seen.signature;
+            const bool check =
+                seen.changed || (last != _last_seen.end() && last->second.changed) ||
+                capio_cl_engine->getCommitRule(data[i]) == CAPIO_FILE_COMMITTED_ON_FILE;
+            changed = changed || seen.changed;
+            _seen.emplace(data[i], seen);
+
+            if (_errors[item] == 0 && check) {
+                LOG("File %s exists. Checking if enough data is available", data[i].c_str());
+                // actual update, end eventual removal from map is handled by the
+                // CapioFileManager class and not by the FileSystemMonitor class
+                file_manager->fileChanged(data[i]);
+            }
+        }
+        _last_seen.swap(_seen);
+        _seen.clear();
+
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        _poll_time += elapsed;
+        _max_poll_time = std::max(_max_poll_time, elapsed);
+        LOG("Probed %ld paths in %ld us. Changes found? %s", _paths.size(),
+            std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count(),
+            changed ? "yes" : "no");
+        return changed;
+    }
+
+    void _add_watch(std::filesystem::path dir) {
+        START_LOG(gettid(), "call(dir=%s)", dir.c_str());
+        int wd;
+        while ((wd = inotify_add_watch(_inotify_fd, dir.c_str(), _mask)) == -1 &&
+               errno == ENOENT && dir.has_relative_path()) {
+            dir = dir.parent_path();
+        }
+        if (wd == -1) {
+            LOG("Unable to watch %s: relying on polling", dir.c_str());
+            return;
+        }
+        LOG("Watching %s", dir.c_str());
+        std::lock_guard<std::mutex> lg(_watch_mutex);
+        _watches[wd] = dir;
+    }
+
+    inline void _watch(const std::filesystem::path &path) {
+        _add_watch(path.parent_path());
+        if (std::filesystem::is_directory(path)) {
+            _add_watch(path);
+        }
+    }
+
+    // Watch again the directories of the awaited files, dropping the ones no longer needed
+    void _rewatch() {
+        START_LOG(gettid(), "call()");
+        std::unordered_map<int, std::filesystem::path> previous;
+        {
+            std::lock_guard<std::mutex> lg(_watch_mutex);
+            previous.swap(_watches);
+        }
+        for (const auto &file : file_manager->getFileAwaitingCreation()) {
+            _watch(file);
+        }
+        for (const auto &file : file_manager->getFileAwaitingData()) {
+            _watch(file);
+        }
+        std::lock_guard<std::mutex> lg(_watch_mutex);
+        for (const auto &[wd, dir] : previous) {
+            if (_watches.find(wd) == _watches.end()) {
+                LOG("Removing watch on %s", dir.c_str());
+                inotify_rm_watch(_inotify_fd, wd);
+            }
+        }
+    }
 
-        timespec sleep{};
-        sleep.tv_nsec = 300; // sleep 0.3 seconds
-        while (*continue_execution) {
-
-            /**
-             * Main idea is to check whether the files exists on the file system.
-             * Then if they exists, wake both thread waiting for file existence
-             * and files waiting for data, as the check on the file size (ie. if
-             * there is enough data) is carried out by the CapioFileManager class
-             * and not by the file_system monitor component itself
-             */
-
-            for (const auto &file : file_manager->getFileAwaitingCreation()) {
-                if (std::filesystem::exists(file)) {
-                    LOG("File %s exists. Unlocking thread awaiting for creation", file.c_str());
-                    file_manager->unlockThreadAwaitingCreation(file);
-                    file_manager->deleteFileAwaitingCreation(file);
-                    LOG("Completed handling.\n\n");
+    void _handle_events() {
+        START_LOG(gettid(), "call()");
+        alignas(inotify_event) char buf[4096];
+        bool overflow = false, new_directories = false;
+
+        ssize_t len;
+        while ((len = read(_inotify_fd, buf, sizeof(buf))) > 0) {
+            const inotify_event *event;
+            for (char *ptr = buf; ptr < buf + len; ptr += sizeof(inotify_event) + event->len) {
+                event = reinterpret_cast<const inotify_event *>(ptr);
+                _events++;
+                if (event->mask & IN_Q_OVERFLOW) {
+                    overflow = true;
+                    continue;
+                }
+                if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+                    new_directories = true;
+                }
+
+                std::filesystem::path dir;
+                {
+                    std::lock_guard<std::mutex> lg(_watch_mutex);
+                    auto it = _watches.find(event->wd);
+                    if (it == _watches.end()) {
+                        continue;
+                    }
+                    dir = it->second;
+                }
+                if (event->len == 0) {
+                    continue;
+                }
+                const auto file = dir / event->name;
+                LOG("Event 0x%x on %s", event->mask, file.c_str());
+                if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    file_manager->setRemoved(file);
+                    continue;
                 }
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    // counted among the entries of dir
+                    file_manager->setExists(file);
+                }
+                file_manager->fileChanged(file);
             }
+        }
+
+        if (overflow) {
+            LOG("Events were lost. Polling all the awaited files");
+            _poll();
+        }
+        if (new_directories) {
+            // awaited files may now have a closer ancestor to watch
+            _rewatch();
+        }
+    }
+
+    void _main() {
+        block_termination_signals();
+        START_LOG(gettid(), "INFO: instance of FileSystemMonitor");
 
-            for (auto &file : file_manager->getFileAwaitingData()) {
-                if (std::filesystem::exists(file)) {
-                    LOG("File %s exists. Checking if enough data is available", file.c_str());
-                    // actual update, end eventual removal from map is handled by the
-                    // CapioFileManager class and not by the FileSystemMonitor class
-                    file_manager->checkAndUnlockThreadAwaitingData(file);
-                    LOG("Completed handling.\n\n");
+        pollfd fds[2]           = {{_wake_fd, POLLIN, 0}, {_inotify_fd, POLLIN, 0}};
+        const nfds_t nfds       = _inotify_fd == -1 ? 1 : 2;
+        const auto min_interval = std::chrono::milliseconds(get_capio_fs_poll_interval());
+        const auto max_interval =
+            std::max(min_interval, std::chrono::milliseconds(CAPIO_FS_POLL_INTERVAL_MAX));
+
+        auto interval  = min_interval;
+        auto next_poll = std::chrono::steady_clock::now() + interval;
+        while (true) {
+            const auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(
+                next_poll - std::chrono::steady_clock::now());
+            if (poll(fds, nfds, std::max(0L, static_cast<long>(timeout.count()))) == -1 &&
+                errno != EINTR) {
+                ERR_EXIT("Unable to wait for file system events");
+            }
+            bool activity = false;
+            if (fds[0].revents & POLLIN) {
+                if (_stop.load()) {
+                    return;
                 }
+                uint64_t wakeups;
+                activity = read(_wake_fd, &wakeups, sizeof(wakeups)) == sizeof(wakeups);
+            }
+            if (nfds == 2 && (fds[1].revents & POLLIN)) {
+                _handle_events();
+                activity = true;
             }
 
-            nanosleep(&sleep, nullptr);
+            const auto now = std::chrono::steady_clock::now();
+            if (now >= next_poll) {
+                activity = _poll() || activity;
+                if (_inotify_fd != -1) {
+                    _rewatch();
+                }
+                interval  = activity ? min_interval : std::min(2 * interval, max_interval);
+                next_poll = std::chrono::steady_clock::now() + interval;
+            } else if (activity && interval > min_interval) {
+                interval  = min_interval;
+                next_poll = std::min(next_poll, now + interval);
+            }
+            _backed_off.store(interval > min_interval);
         }
     }
 
+  public:
     explicit FileSystemMonitor() {
         START_LOG(gettid(), "call()");
-        *continue_execution = true;
-        th                  = new std::thread(_main, std::ref(continue_execution));
+        _wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (_wake_fd == -1) {
+            ERR_EXIT("Unable to create eventfd for FileSystemMonitor");
+        }
+        _inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (_inotify_fd == -1) {
+            std::cout << CAPIO_LOG_SERVER_CLI_LEVEL_WARNING << " [ " << node_name << " ] "
+                      << "inotify not available (" << strerror(errno)
+                      << "): awaited files are only polled" << std::endl;
+        }
+        if (!_ring.available()) {
+            std::cout << CAPIO_LOG_SERVER_CLI_LEVEL_WARNING << " [ " << node_name << " ] "
+                      << "io_uring not available: awaited files are polled one at a time"
+                      << std::endl;
+        }
+        th = new std::thread(&FileSystemMonitor::_main, this);
         std::cout << CAPIO_SERVER_CLI_LOG_SERVER << " [ " << node_name << " ] "
                   << "CapioFileSystemMonitor initialization completed." << std::endl;
     }
 
     ~FileSystemMonitor() {
         START_LOG(gettid(), "call()");
-        *continue_execution = false;
-        pthread_cancel(th->native_handle());
+        _stop.store(true);
+        const uint64_t stop = 1;
+        if (write(_wake_fd, &stop, sizeof(stop)) != sizeof(stop)) {
+            ERR_EXIT("Unable to stop FileSystemMonitor");
+        }
         th->join();
         delete th;
-        delete continue_execution;
+        std::cout << CAPIO_SERVER_CLI_LOG_SERVER << " [ " << node_name << " ] "
+                  << "File system events: " << _events << ", polls: " << _polls
+                  << ", paths probed: " << _probed << ", poll time: "
+                  << (_polls == 0 ? 0 : _poll_time.count() / 1000 / _polls) << " us on average, "
+                  << _max_poll_time.count() / 1000 << " us at most" << std::endl;
+        if (_inotify_fd != -1) {
+            close(_inotify_fd);
+        }
+        close(_wake_fd);
+    }
+
+    /**
+     * Watch the parent directory of @param path, which a client is waiting for, and @param path
+     * itself if it is a directory. A directory that does not exist yet is replaced by its closest
+     * existing ancestor, until it is created. Polls get frequent again if they were backed off
+     * @param path
+     */
+    inline void watch(const std::filesystem::path &path) {
+        START_LOG(gettid(), "call(path=%s)", path.c_str());
+        if (_backed_off.exchange(false)) {
+            const uint64_t wakeup = 1;
+            if (write(_wake_fd, &wakeup, sizeof(wakeup)) != sizeof(wakeup)) {
+                ERR_EXIT("Unable to wake up FileSystemMonitor");
+            }
+        }
+        if (_inotify_fd != -1) {
+            _watch(path);
+        }
     }
 };
 
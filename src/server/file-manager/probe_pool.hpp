@@ -0,0 +1,140 @@
+#ifndef CAPIO_PROBE_POOL_HPP
+#define CAPIO_PROBE_POOL_HPP
+
+#include <mutex>
+#include <thread>
+
+#include "capio/semaphore.hpp"
+#include "utils/common.hpp"
+
+struct ProbeJob;
+typedef void (*CSProbe_t)(const ProbeJob &);
+
+/**
+ * Continuation of a request handler: the rest of the handling, which probes the file system and
+ * then replies to the client or parks it among the threads waiting for a file
+ */
+struct ProbeJob {
+    CSProbe_t probe;
+    pid_t tid;
+    capio_off64_t offset; // meaning depends on the probe
+    std::string path;
+};
+
+/**
+ * Pool of threads running ProbeJob. Metadata round-trips to a parallel file system take much
+ * longer than the handling of a request, so handlers submit them here instead of waiting. Probes
+ * are started in submission order, but may complete in any order.
+ */
+class ProbePool {
+    std::vector<ProbeJob> _jobs; // ring of CAPIO_PROBE_QUEUE_DEPTH jobs
+    unsigned long long _head = 0, _tail = 0;
+    std::mutex _mutex; // guards _jobs, _head and _tail
+    FutexWord _ready{}, _slots{};
+    std::vector<std::thread *> _threads;
+    std::atomic<bool> _stop{false};
+    std::atomic<unsigned long long> _probes{0};
+
+    void _main() {
+        block_termination_signals();
+        START_LOG(gettid(), "INFO: instance of ProbePool");
+        FutexSemaphore ready(&_ready, 0, false);
+        FutexSemaphore slots(&_slots, 0, false);
+
+        ProbeJob job{};
+        while (true) {
+            ready.lock();
+            if (_stop.load()) {
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lg(_mutex);
+                auto &next = _jobs[_head++ % CAPIO_PROBE_QUEUE_DEPTH];
+                job.probe  = next.probe;
+                job.tid    = next.tid;
+                job.offset = next.offset;
+                // swapping keeps the capacity of both strings, so paths are not reallocated
+                job.path.swap(next.path);
+            }
+            slots.unlock();
+            job.probe(job);
+            request_arena.reset();
+            _probes.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+  public:
+    explicit ProbePool(int nr_workers) {
+        START_LOG(gettid(), "call(nr_workers=%d)", nr_workers);
+        _jobs.resize(CAPIO_PROBE_QUEUE_DEPTH);
+        FutexSemaphore(&_ready, 0, true);
+        FutexSemaphore(&_slots, CAPIO_PROBE_QUEUE_DEPTH, true);
+        for (int i = 0; i < nr_workers; ++i) {
+            _threads.emplace_back(new std::thread(&ProbePool::_main, this));
+        }
+        std::cout << CAPIO_SERVER_CLI_LOG_SERVER << " [ " << node_name << " ] "
+                  << "ProbePool initialization completed (" << nr_workers << " workers)."
+                  << std::endl;
+    }
+
+    ProbePool(const ProbePool &)            = delete;
+    ProbePool &operator=(const ProbePool &) = delete;
+    ~ProbePool() {
+        START_LOG(gettid(), "call()");
+        _stop.store(true);
+        FutexSemaphore(&_ready, 0, false).unlock(static_cast<int>(_threads.size()));
+        for (auto th : _threads) {
+            th->join();
+            delete th;
+        }
+        std::cout << CAPIO_SERVER_CLI_LOG_SERVER << " [ " << node_name << " ] "
+                  << "File system probes run asynchronously: " << _probes << std::endl;
+    }
+
+    /**
+     * Queue @param probe for thread @param tid on @param path. Blocks while the queue is full
+     * @param probe
+     * @param tid
+     * @param path
+     * @param offset
+     */
+    inline void submit(CSProbe_t probe, pid_t tid, const char *path, capio_off64_t offset) {
+        START_LOG(gettid(), "call(tid=%d, path=%s, offset=%llu)", tid, path, offset);
+        FutexSemaphore(&_slots, 0, false).lock();
+        {
+            std::lock_guard<std::mutex> lg(_mutex);
+            auto &job  = _jobs[_tail++ % CAPIO_PROBE_QUEUE_DEPTH];
+            job.probe  = probe;
+            job.tid    = tid;
+            job.offset = offset;
+            job.path.assign(path);
+        }
+        FutexSemaphore(&_ready, 0, false).unlock();
+    }
+};
+
+inline ProbePool *probe_pool = nullptr;
+
+/**
+ * Run @param probe for thread @param tid on @param path on the probe pool, or right away if the
+ * pool is disabled
+ * @param probe
+ * @param tid
+ * @param path
+ * @param offset
+ */
+inline void submit_probe(CSProbe_t probe, pid_t tid, const char *path, capio_off64_t offset = 0) {
+    if (probe_pool == nullptr) {
+        // the path of the job is kept, so that its buffer is reused by the next probe
+        static thread_local ProbeJob job{};
+        job.probe  = probe;
+        job.tid    = tid;
+        job.offset = offset;
+        job.path.assign(path);
+        probe(job);
+        return;
+    }
+    probe_pool->submit(probe, tid, path, offset);
+}
+
+#endif // CAPIO_PROBE_POOL_HPP
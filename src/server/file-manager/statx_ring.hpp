@@ -0,0 +1,191 @@
+#ifndef CAPIO_STATX_RING_HPP
+#define CAPIO_STATX_RING_HPP
+
+#include <filesystem>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+/**
+ * Gets the metadata of many paths with a few system calls, by submitting batches of
+ * IORING_OP_STATX requests on an io_uring. On kernels without io_uring, or where it is
+ * disabled, one statx is issued per path instead.
+ */
+class StatxRing {
+    int _fd               = -1;
+    unsigned int _entries = 0; // submission queue entries
+
+    void *_sq_ring            = MAP_FAILED, *_cq_ring = MAP_FAILED;
+    std::size_t _sq_ring_size = 0, _cq_ring_size = 0;
+    io_uring_sqe *_sqes       = static_cast<io_uring_sqe *>(MAP_FAILED);
+    std::size_t _sqes_size    = 0;
+
+    unsigned int *_sq_tail = nullptr, *_sq_mask = nullptr;
+    unsigned int *_cq_head = nullptr, *_cq_tail = nullptr, *_cq_mask = nullptr;
+    io_uring_cqe *_cqes    = nullptr;
+
+    template <class T> static T *_at(void *ring, __u32 offset) {
+        return reinterpret_cast<T *>(static_cast<char *>(ring) + offset);
+    }
+
+    // Map the rings of _fd. Returns false if the kernel refuses to
+    bool _map(const io_uring_params &params) {
+        _sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(__u32);
+        _cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            _sq_ring_size = _cq_ring_size = std::max(_sq_ring_size, _cq_ring_size);
+        }
+        _sq_ring = mmap(nullptr, _sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        _fd, IORING_OFF_SQ_RING);
+        if (_sq_ring == MAP_FAILED) {
+            return false;
+        }
+        _cq_ring = _sq_ring;
+        if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+            _cq_ring = mmap(nullptr, _cq_ring_size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING);
+            if (_cq_ring == MAP_FAILED) {
+                return false;
+            }
+        }
+        _sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        _sqes      = static_cast<io_uring_sqe *>(mmap(nullptr, _sqes_size, PROT_READ | PROT_WRITE,
+                                                      MAP_SHARED | MAP_POPULATE, _fd,
+                                                      IORING_OFF_SQES));
+        if (_sqes == MAP_FAILED) {
+            return false;
+        }
+
+        _sq_tail = _at<unsigned int>(_sq_ring, params.sq_off.tail);
+        _sq_mask = _at<unsigned int>(_sq_ring, params.sq_off.ring_mask);
+        _cq_head = _at<unsigned int>(_cq_ring, params.cq_off.head);
+        _cq_tail = _at<unsigned int>(_cq_ring, params.cq_off.tail);
+        _cq_mask = _at<unsigned int>(_cq_ring, params.cq_off.ring_mask);
+        _cqes    = _at<io_uring_cqe>(_cq_ring, params.cq_off.cqes);
+
+        // submission entries are always used in ring order
+        auto array = _at<unsigned int>(_sq_ring, params.sq_off.array);
+        for (unsigned int i = 0; i < params.sq_entries; ++i) {
+            array[i] = i;
+        }
+        _entries = params.sq_entries;
+        return true;
+    }
+
+    void _unmap() {
+        if (_sqes != MAP_FAILED) {
+            munmap(_sqes, _sqes_size);
+        }
+        if (_cq_ring != MAP_FAILED && _cq_ring != _sq_ring) {
+            munmap(_cq_ring, _cq_ring_size);
+        }
+        if (_sq_ring != MAP_FAILED) {
+            munmap(_sq_ring, _sq_ring_size);
+        }
+        _sqes    = static_cast<io_uring_sqe *>(MAP_FAILED);
+        _sq_ring = _cq_ring = MAP_FAILED;
+    }
+
+    // Collect the completions available on the ring. Returns how many were collected
+    unsigned int _reap(std::vector<int> &errors) {
+        const unsigned int tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+        unsigned int head       = *_cq_head, reaped = 0;
+        for (; head != tail; ++head, ++reaped) {
+            const auto &cqe       = _cqes[head & *_cq_mask];
+            errors[cqe.user_data] = cqe.res < 0 ? -cqe.res : 0;
+        }
+        __atomic_store_n(_cq_head, head, __ATOMIC_RELEASE);
+        return reaped;
+    }
+
+    void _statx_batch(const std::vector<std::string> &paths, std::size_t first, unsigned int count,
+                      std::vector<struct statx> &results, std::vector<int> &errors) {
+        START_LOG(gettid(), "call(first=%ld, count=%u)", first, count);
+        unsigned int tail = *_sq_tail;
+        for (std::size_t i = first; i < first + count; ++i, ++tail) {
+            auto &sqe       = _sqes[tail & *_sq_mask];
+            sqe             = {};
+            sqe.opcode      = IORING_OP_STATX;
+            sqe.fd          = AT_FDCWD;
+            sqe.addr        = reinterpret_cast<__u64>(paths[i].c_str());
+            sqe.len         = STATX_TYPE | STATX_SIZE | STATX_MTIME;
+            sqe.off         = reinterpret_cast<__u64>(&results[i]);
+            sqe.statx_flags = AT_STATX_SYNC_AS_STAT;
+            sqe.user_data   = i;
+        }
+        __atomic_store_n(_sq_tail, tail, __ATOMIC_RELEASE);
+
+        unsigned int submitted = 0, completed = 0;
+        while (completed < count) {
+            const long res = syscall(SYS_io_uring_enter, _fd, count - submitted, 1,
+                                     IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (res == -1 && errno != EINTR) {
+                ERR_EXIT("Unable to submit statx requests");
+            }
+            submitted += res > 0 ? res : 0;
+            completed += _reap(errors);
+        }
+    }
+
+  public:
+    explicit StatxRing(unsigned int entries) {
+        START_LOG(gettid(), "call(entries=%u)", entries);
+        io_uring_params params{};
+        _fd = static_cast<int>(syscall(SYS_io_uring_setup, entries, &params));
+        if (_fd == -1) {
+            LOG("io_uring not available: %s", strerror(errno));
+            return;
+        }
+        if (!_map(params)) {
+            LOG("Unable to map io_uring: %s", strerror(errno));
+            _unmap();
+            close(_fd);
+            _fd = -1;
+        }
+    }
+
+    StatxRing(const StatxRing &)            = delete;
+    StatxRing &operator=(const StatxRing &) = delete;
+    ~StatxRing() {
+        if (_fd != -1) {
+            _unmap();
+            close(_fd);
+        }
+    }
+
+    [[nodiscard]] inline bool available() const { return _fd != -1; }
+
+    /**
+     * Get the metadata of each path of @param paths into the matching item of @param results, and
+     * set the matching item of @param errors to 0, or to the errno of the failed statx
+     * @param paths
+     * @param results
+     * @param errors
+     */
+    inline void statx(const std::vector<std::string> &paths, std::vector<struct statx> &results,
+                      std::vector<int> &errors) {
+        START_LOG(gettid(), "call(paths=%ld)", paths.size());
+        results.resize(paths.size());
+        errors.resize(paths.size());
+        if (_fd == -1) {
+            for (std::size_t i = 0; i < paths.size(); ++i) {
+                errors[i] = ::statx(AT_FDCWD, paths[i].c_str(), AT_STATX_SYNC_AS_STAT,
+                                    STATX_TYPE | STATX_SIZE | STATX_MTIME, &results[i]) == -1
+                                ? errno
+                                : 0;
+            }
+            return;
+        }
+        for (std::size_t first = 0; first < paths.size(); first += _entries) {
+            const auto count = static_cast<unsigned int>(
+                std::min<std::size_t>(_entries, paths.size() - first));
+            _statx_batch(paths, first, count, results, errors);
+        }
+    }
+};
+
+#endif // CAPIO_STATX_RING_HPP
@@ -1,9 +1,12 @@
 #ifndef CAPIO_SERVER_UTILS_COMMON_HPP
 #define CAPIO_SERVER_UTILS_COMMON_HPP
 
+#include <csignal>
 #include <string>
 
 #include "capio/constants.hpp"
+#include "request_arena.hpp"
+#include "request_stats.hpp"
 #include "types.hpp"
 
 inline bool first_is_subpath_of_second(const std::filesystem::path &path,
@@ -12,6 +15,19 @@ inline bool first_is_subpath_of_second(const std::filesystem::path &path,
     return mismatch_pair.second == base.end();
 }
 
+/**
+ * Block termination signals in the calling thread. They are then delivered to the main thread,
+ * whose handler joins the helper threads of the server
+ */
+inline void block_termination_signals() {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGQUIT);
+    pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+}
+
 inline bool is_int(const std::string &s) {
     START_LOG(gettid(), "call(%s)", s.c_str());
     bool res = false;
@@ -29,7 +45,7 @@ inline bool is_int(const std::string &s) {
  * @param to_match string to check
  * @return
  */
-inline bool match_globs(std::string glob, std::string to_match) {
+inline bool match_globs(const std::string &glob, const std::string &to_match) {
     bool matches = true;
 
     if (glob.empty()) {
@@ -44,7 +60,7 @@ inline bool match_globs(std::string glob, std::string to_match) {
             if (glob.back() == '*') {
                 return true;
             }
-            std::string glob_end = glob.substr(glob.find('*') + 1, glob.size());
+            const auto glob_end = std::string_view(glob).substr(glob.find('*') + 1);
             return to_match.compare(to_match_size - glob_end.size(), glob_end.size(), glob_end);
         }
 
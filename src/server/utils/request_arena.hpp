@@ -0,0 +1,34 @@
+#ifndef CAPIO_SERVER_UTILS_REQUEST_ARENA_HPP
+#define CAPIO_SERVER_UTILS_REQUEST_ARENA_HPP
+
+#include <deque>
+#include <string>
+#include <string_view>
+
+/**
+ * Scratch memory for the temporaries of the request a thread is handling, such as the paths used
+ * as keys of the tables of the server, which need a std::string to be looked up. Strings are
+ * handed out in order and all given back at once after the request has been dispatched. Their
+ * buffers are kept, so once the arena has grown to fit the paths of the workflow, requests are
+ * handled without allocating
+ */
+class RequestArena {
+    std::deque<std::string> _strings; // a deque does not move the strings already handed out
+    std::size_t _used = 0;
+
+  public:
+    // Copy @param str into the next string of the arena, which is valid until the arena is reset
+    inline const std::string &string(std::string_view str) {
+        if (_used == _strings.size()) {
+            _strings.emplace_back();
+        }
+        return _strings[_used++].assign(str);
+    }
+
+    // Give back all the strings handed out since the last reset
+    inline void reset() { _used = 0; }
+};
+
+inline thread_local RequestArena request_arena;
+
+#endif // CAPIO_SERVER_UTILS_REQUEST_ARENA_HPP
@@ -0,0 +1,216 @@
+#ifndef CAPIO_SERVER_UTILS_REQUEST_STATS_HPP
+#define CAPIO_SERVER_UTILS_REQUEST_STATS_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+#include "capio/constants.hpp"
+#include "capio/requests.hpp"
+
+/**
+ * Line of text of at most Size - 1 characters, built on the stack without snprintf, which is not
+ * async-signal-safe. Text that does not fit is dropped
+ */
+template <std::size_t Size> class StatsLine {
+    char _buf[Size];
+    std::size_t _len = 0;
+
+  public:
+    StatsLine() { _buf[0] = '\0'; }
+
+    inline StatsLine &operator<<(const char *str) {
+        while (*str != '\0' && _len < Size - 1) {
+            _buf[_len++] = *str++;
+        }
+        _buf[_len] = '\0';
+        return *this;
+    }
+
+    inline StatsLine &operator<<(unsigned long long value) {
+        char digits[20];
+        int nr_digits = 0;
+        do {
+            digits[nr_digits++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value > 0);
+        while (nr_digits > 0 && _len < Size - 1) {
+            _buf[_len++] = digits[--nr_digits];
+        }
+        _buf[_len] = '\0';
+        return *this;
+    }
+
+    inline void clear() {
+        _len    = 0;
+        _buf[0] = '\0';
+    }
+
+    [[nodiscard]] inline const char *c_str() const { return _buf; }
+
+    [[nodiscard]] inline std::size_t size() const { return _len; }
+};
+
+typedef StatsLine<CAPIO_CTL_MSG_MAX_SIZE> CapioStatsLine;
+
+/**
+ * Histogram of durations in nanoseconds, with buckets of logarithmic size as in HDR histograms:
+ * every power of two is split in SUB_BUCKETS buckets, so values are counted with a relative error
+ * below 1 / SUB_BUCKETS. Values from 2^MAX_LOG2 nanoseconds on share the last bucket. Counters
+ * are updated with relaxed atomics, so threads can record and read values concurrently without
+ * locks or allocations
+ */
+class LatencyHistogram {
+    static constexpr int SUB_BITS                   = 3;
+    static constexpr unsigned long long SUB_BUCKETS = 1ULL << SUB_BITS;
+    static constexpr int MAX_LOG2                   = 40; // about 18 minutes
+    static constexpr int NR_BUCKETS                 = (MAX_LOG2 - SUB_BITS + 2) * SUB_BUCKETS;
+
+    std::array<std::atomic<unsigned long long>, NR_BUCKETS> _buckets{};
+    std::atomic<unsigned long long> _count{0}, _sum{0}, _max{0};
+
+    static inline int _bucket(unsigned long long value) {
+        if (value < SUB_BUCKETS) {
+            return static_cast<int>(value);
+        }
+        const int log2 = std::min(63 - __builtin_clzll(value), MAX_LOG2);
+        if (log2 == MAX_LOG2) {
+            return NR_BUCKETS - 1;
+        }
+        const unsigned long long top = value >> (log2 - SUB_BITS);
+        return static_cast<int>((log2 - SUB_BITS + 1) * SUB_BUCKETS + top - SUB_BUCKETS);
+    }
+
+    // Smallest value counted in @param bucket
+    static inline unsigned long long _lower_bound(int bucket) {
+        const int group = bucket / SUB_BUCKETS;
+        if (group == 0) {
+            return bucket;
+        }
+        return (SUB_BUCKETS + bucket % SUB_BUCKETS) << (group - 1);
+    }
+
+  public:
+    inline void record(unsigned long long value) {
+        _buckets[_bucket(value)].fetch_add(1, std::memory_order_relaxed);
+        _count.fetch_add(1, std::memory_order_relaxed);
+        _sum.fetch_add(value, std::memory_order_relaxed);
+        unsigned long long max = _max.load(std::memory_order_relaxed);
+        while (value > max && !_max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    [[nodiscard]] inline unsigned long long count() const {
+        return _count.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] inline unsigned long long mean() const {
+        const unsigned long long count = this->count();
+        return count == 0 ? 0 : _sum.load(std::memory_order_relaxed) / count;
+    }
+
+    [[nodiscard]] inline unsigned long long max() const {
+        return _max.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Return an upper bound of the value below which @param permille thousandths of the recorded
+     * values fall, that is the largest value of the bucket holding it
+     * @param permille
+     * @return
+     */
+    [[nodiscard]] inline unsigned long long percentile(unsigned int permille) const {
+        const unsigned long long count = this->count();
+        const unsigned long long rank  = (count * permille + 999) / 1000;
+        unsigned long long seen        = 0;
+        for (int bucket = 0; bucket < NR_BUCKETS - 1; ++bucket) {
+            seen += _buckets[bucket].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                return std::min(_lower_bound(bucket + 1) - 1, max());
+            }
+        }
+        return max();
+    }
+
+    // Append a summary of the histogram to @param line
+    inline void summary(CapioStatsLine &line) const {
+        line << count() << " requests, mean " << mean() << " ns, p50 " << percentile(500)
+             << " ns, p90 " << percentile(900) << " ns, p99 " << percentile(990) << " ns, max "
+             << max() << " ns";
+    }
+};
+
+/**
+ * Latency of the requests handled by the server, by request code: the time a request waited
+ * between the client issuing it and the server taking it from its lane, and the time its handler
+ * ran. Together with the threads parked waiting for a file and woken up again, and with the write
+ * notifications merged into a later one, they are printed on SIGUSR1 and returned to capioctl.
+ * Statistics are always collected, as recording a value only costs a few relaxed atomic
+ * increments
+ */
+class RequestStats {
+    std::array<LatencyHistogram, CAPIO_NR_REQUESTS> _queued, _service;
+    std::atomic<unsigned long long> _parked{0}, _woken{0}, _coalesced{0};
+
+    static constexpr std::array<const char *, CAPIO_NR_REQUESTS> _names = {
+        "consent", "clone", "close", "create", "exit_group", "handshake_named",
+        "handshake_anonymous", "mkdir", "open", "read", "rename", "write"};
+
+  public:
+    // Record that a request with code @param code waited for @param ns nanoseconds in its lane
+    inline void queued(int code, long int ns) { _queued[code].record(std::max(ns, 0L)); }
+
+    // Record that the handler of a request with code @param code ran for @param ns nanoseconds
+    inline void served(int code, long int ns) { _service[code].record(std::max(ns, 0L)); }
+
+    // Record that a thread was parked waiting for a file
+    inline void parked() { _parked.fetch_add(1, std::memory_order_relaxed); }
+
+    // Record that @param count parked threads were woken up
+    inline void woken(unsigned long long count) {
+        _woken.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    // Record that a write notification was merged into a later one
+    inline void coalesced() { _coalesced.fetch_add(1, std::memory_order_relaxed); }
+
+    [[nodiscard]] inline unsigned long long coalesced_writes() const {
+        return _coalesced.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Pass to @param sink, one line at a time, the statistics of every request code the server
+     * received. Lines are formatted on the stack without snprintf, so this can be called from a
+     * signal handler
+     * @tparam Sink callable taking a const char *
+     * @param sink
+     */
+    template <class Sink> inline void print(Sink &&sink) const {
+        CapioStatsLine line;
+        for (int code = 0; code < CAPIO_NR_REQUESTS; ++code) {
+            if (_queued[code].count() == 0 && _service[code].count() == 0) {
+                continue;
+            }
+            line.clear();
+            line << _names[code] << " queue: ";
+            _queued[code].summary(line);
+            sink(line.c_str());
+            line.clear();
+            line << _names[code] << " service: ";
+            _service[code].summary(line);
+            sink(line.c_str());
+        }
+        line.clear();
+        line << "Threads parked waiting for a file: " << _parked.load(std::memory_order_relaxed)
+             << ", woken up: " << _woken.load(std::memory_order_relaxed);
+        sink(line.c_str());
+        line.clear();
+        line << "Write notifications merged into a later one: " << coalesced_writes();
+        sink(line.c_str());
+    }
+};
+
+inline RequestStats request_stats;
+
+#endif // CAPIO_SERVER_UTILS_REQUEST_STATS_HPP
@@ -30,9 +30,6 @@ inline void sig_term_handler(int signum, siginfo_t *info, void *ptr) {
     delete ctl_module;
     std::cout << CAPIO_LOG_SERVER_CLI_LEVEL_WARNING << " [ " << node_name << " ] "
               << "ctl_module cleanup completed" << std::endl;
-    delete fs_monitor;
-    std::cout << CAPIO_LOG_SERVER_CLI_LEVEL_WARNING << " [ " << node_name << " ] "
-              << "fs_monitor cleanup completed" << std::endl;
     delete shm_canary;
     std::cout << CAPIO_LOG_SERVER_CLI_LEVEL_INFO << " [ " << node_name << " ] "
               << "shutdown completed" << std::endl;
@@ -40,6 +37,20 @@ inline void sig_term_handler(int signum, siginfo_t *info, void *ptr) {
     exit(EXIT_SUCCESS);
 }
 
+/**
+ * Print the request statistics of the server. Lines are built without snprintf and written with
+ * write(), as the signal may interrupt a thread that is formatting or printing on std::cout
+ */
+inline void sig_stats_handler(int signum) {
+    const int saved_errno = errno;
+    request_stats.print([](const char *line) {
+        StatsLine<CAPIO_CTL_MSG_MAX_SIZE + HOST_NAME_MAX + 64> out;
+        out << CAPIO_SERVER_CLI_LOG_SERVER << " [ " << node_name << " ] " << line << "\n";
+        [[maybe_unused]] const ssize_t written = write(STDOUT_FILENO, out.c_str(), out.size());
+    });
+    errno = saved_errno;
+}
+
 inline void setup_signal_handlers() {
     START_LOG(gettid(), "call()");
     static struct sigaction sigact;
@@ -57,6 +68,14 @@ inline void setup_signal_handlers() {
     if (res == -1) {
         ERR_EXIT("sigaction for SIGTERM");
     }
+
+    static struct sigaction stats_sigact;
+    memset(&stats_sigact, 0, sizeof(stats_sigact));
+    stats_sigact.sa_handler = sig_stats_handler;
+    stats_sigact.sa_flags   = SA_RESTART;
+    if (sigaction(SIGUSR1, &stats_sigact, nullptr) == -1) {
+        ERR_EXIT("sigaction for SIGUSR1");
+    }
 }
 
 #endif // CAPIO_SERVER_HANDLERS_SIGNALS_HPP
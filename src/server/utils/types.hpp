@@ -6,11 +6,16 @@
 #include <unordered_set>
 #include <vector>
 
+#include "capio/framed_queue.hpp"
+#include "capio/mailbox.hpp"
 #include "capio/queue.hpp"
+#include "capio/request_shards.hpp"
+#include "capio/wake_board.hpp"
 
-typedef std::unordered_map<int, CircularBuffer<capio_off64_t> *> CSBufResponse_t;
-typedef CircularBuffer<char> CSBufRequest_t;
+typedef std::unordered_map<int, CapioMailbox *> CSBufResponse_t;
+typedef RequestShards CSBufRequest_t;
 
-typedef void (*CSHandler_t)(const char *const);
+typedef void (*CSHandler_t)(const char *const, const long int);
+typedef std::size_t (*CSRoute_t)(const char *const, const long int);
 
 #endif // CAPIO_SERVER_UTILS_TYPES_HPP
@@ -0,0 +1,206 @@
+#ifndef CAPIO_COMMON_UNIT_TESTS_FRAMED_QUEUE_HPP
+#define CAPIO_COMMON_UNIT_TESTS_FRAMED_QUEUE_HPP
+
+#include <string>
+#include <thread>
+
+#include "capio/framed_queue.hpp"
+
+class FramedQueueTest : public testing::Test {
+  protected:
+    const std::string workflow = "capio_unit_tests_" + std::to_string(getpid());
+    FramedQueue *queue         = nullptr;
+
+    void SetUp() override { queue = new FramedQueue("framed", 4096, workflow); }
+
+    void TearDown() override { delete queue; }
+
+    // Fill @param buf with @param size bytes derived from @param seed
+    static void fill(char *buf, long int size, int seed) {
+        for (long int i = 0; i < size; ++i) {
+            buf[i] = static_cast<char>('a' + (seed + i) % 26);
+        }
+    }
+
+    static bool check(const char *buf, long int size, int seed) {
+        for (long int i = 0; i < size; ++i) {
+            if (buf[i] != static_cast<char>('a' + (seed + i) % 26)) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+TEST_F(FramedQueueTest, TestRecordsAreReadInOrder) {
+    char buf[512];
+    long int offset = 0;
+    for (int i = 1; i <= 3; ++i) {
+        fill(buf, i * 100, i);
+        queue->write(buf, i * 100);
+        offset += framed_record_stride(i * 100);
+    }
+    for (int i = 1; i <= 3; ++i) {
+        EXPECT_EQ(queue->read(buf), i * 100);
+        EXPECT_TRUE(check(buf, i * 100, i));
+    }
+    EXPECT_EQ(queue->head(), offset);
+}
+
+TEST_F(FramedQueueTest, TestRecordsWrapAroundTheEndOfTheDataArea) {
+    char buf[1024];
+    long int offset = 0;
+    for (int i = 0; i < 200; ++i) {
+        const long int size = 1 + (i * 37) % 1000;
+        fill(buf, size, i);
+        queue->write(buf, size);
+        offset += framed_record_stride(size);
+
+        memset(buf, 0, sizeof(buf));
+        ASSERT_EQ(queue->read(buf), size);
+        ASSERT_TRUE(check(buf, size, i)) << "record " << i << " at offset " << offset;
+    }
+    EXPECT_EQ(queue->head(), offset);
+    EXPECT_GT(offset, 10 * 4096);
+}
+
+TEST_F(FramedQueueTest, TestRecordCrossingTheEndOfTheDataAreaIsContiguous) {
+    char buf[4096];
+    // leave 64 bytes before the end of the data area
+    const long int first = 4096 - 64 - static_cast<long int>(sizeof(FramedRecord));
+    fill(buf, first, 0);
+    queue->write(buf, first);
+    ASSERT_EQ(queue->read(buf), first);
+
+    char *payload = queue->reserve(512);
+    fill(payload, 512, 1);
+    queue->commit(payload, 512);
+    memset(buf, 0, sizeof(buf));
+    EXPECT_EQ(queue->read(buf), 512);
+    EXPECT_TRUE(check(buf, 512, 1));
+}
+
+TEST_F(FramedQueueTest, TestProducerWaitsForFreeSpace) {
+    char buf[4096];
+    const long int size = 1000 - static_cast<long int>(sizeof(FramedRecord));
+    for (int i = 0; i < 4; ++i) {
+        fill(buf, size, i);
+        queue->write(buf, size);
+    }
+
+    std::atomic<bool> written{false};
+    std::thread producer([&] {
+        char data[1024];
+        fill(data, size, 4);
+        queue->write(data, size);
+        written.store(true);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_FALSE(written.load());
+
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_EQ(queue->read(buf), size);
+        EXPECT_TRUE(check(buf, size, i));
+    }
+    producer.join();
+    EXPECT_TRUE(written.load());
+}
+
+TEST_F(FramedQueueTest, TestBatchIsPublishedWithASingleReservation) {
+    FramedBatch batch(1024);
+    long int stride = 0;
+    for (int i = 1; i <= 3; ++i) {
+        fill(batch.append(i * 10), i * 10, i);
+        stride += framed_record_stride(i * 10);
+    }
+    EXPECT_EQ(batch.count(), 3);
+    EXPECT_EQ(batch.size(), stride);
+
+    EXPECT_EQ(queue->write(batch), stride);
+    EXPECT_EQ(batch.count(), 0);
+    EXPECT_EQ(queue->available(), 3);
+    EXPECT_EQ(queue->wait_records(), 3);
+    for (int i = 1; i <= 3; ++i) {
+        long int size;
+        const char *payload = queue->acquire(&size);
+        EXPECT_EQ(size, i * 10);
+        EXPECT_TRUE(check(payload, size, i));
+        queue->release();
+    }
+    EXPECT_EQ(queue->available(), 0);
+}
+
+TEST_F(FramedQueueTest, TestRecordsAreAcquiredInReservationOrder) {
+    char *first  = queue->reserve(100);
+    char *second = queue->reserve(200);
+    fill(second, 200, 2);
+    queue->commit(second, 200);
+
+    std::atomic<long int> acquired{0};
+    std::thread consumer([&] {
+        EXPECT_EQ(queue->wait_records(), 1);
+        long int size;
+        const char *payload = queue->acquire(&size);
+        EXPECT_TRUE(check(payload, size, 1));
+        acquired.store(size);
+        queue->release();
+
+        EXPECT_EQ(queue->wait_records(), 1);
+        payload = queue->acquire(&size);
+        EXPECT_EQ(size, 200);
+        EXPECT_TRUE(check(payload, size, 2));
+        queue->release();
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(acquired.load(), 0);
+
+    fill(first, 100, 1);
+    queue->commit(first, 100);
+    consumer.join();
+    EXPECT_EQ(acquired.load(), 100);
+    EXPECT_EQ(queue->available(), 0);
+}
+
+TEST_F(FramedQueueTest, TestRecordOfTerminatedProducerIsSkipped) {
+    std::thread producer([&] { queue->reserve(100); });
+    producer.join();
+
+    char buf[512];
+    fill(buf, 200, 1);
+    queue->write(buf, 200);
+    memset(buf, 0, sizeof(buf));
+    EXPECT_EQ(queue->read(buf), 200);
+    EXPECT_TRUE(check(buf, 200, 1));
+    EXPECT_EQ(queue->head(), framed_record_stride(100) + framed_record_stride(200));
+    EXPECT_EQ(queue->available(), 0);
+}
+
+TEST_F(FramedQueueTest, TestSharedDoorbellIsRungOnlyWhileTheConsumerIsParked) {
+    FramedQueue other("framed_other", 4096, workflow);
+    FutexWord *doorbell = queue->doorbell();
+    queue->share_doorbell(doorbell);
+    other.share_doorbell(doorbell);
+
+    char buf[64];
+    fill(buf, 64, 1);
+    other.write(buf, 64);
+    EXPECT_EQ(other.available(), 1);
+    EXPECT_EQ(doorbell->value.load(), 0);
+
+    std::thread consumer([&] {
+        doorbell->waiters.fetch_add(1);
+        while (queue->available() == 0) {
+            capio_futex_wait(&doorbell->value, 0);
+        }
+        doorbell->waiters.fetch_sub(1);
+    });
+    while (doorbell->waiters.load() == 0) {
+        std::this_thread::yield();
+    }
+    queue->write(buf, 64);
+    consumer.join();
+    EXPECT_EQ(doorbell->value.load(), 1);
+    EXPECT_EQ(queue->available(), 1);
+}
+
+#endif // CAPIO_COMMON_UNIT_TESTS_FRAMED_QUEUE_HPP
@@ -0,0 +1,95 @@
+#ifndef CAPIO_COMMON_UNIT_TESTS_FUTEX_SEMAPHORE_HPP
+#define CAPIO_COMMON_UNIT_TESTS_FUTEX_SEMAPHORE_HPP
+
+#include <thread>
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "capio/semaphore.hpp"
+
+class FutexSemaphoreTest : public testing::Test {
+  protected:
+    FutexWord word{};
+};
+
+TEST_F(FutexSemaphoreTest, TestTryLockDecrementsPositiveCounter) {
+    FutexSemaphore semaphore(&word, 2, true);
+    EXPECT_TRUE(semaphore.try_lock());
+    EXPECT_TRUE(semaphore.try_lock());
+    EXPECT_FALSE(semaphore.try_lock());
+    EXPECT_EQ(word.value.load(), 0);
+}
+
+TEST_F(FutexSemaphoreTest, TestLockDoesNotWaitWhenCounterIsPositive) {
+    FutexSemaphore semaphore(&word, 1, true);
+    semaphore.lock();
+    EXPECT_EQ(word.value.load(), 0);
+    EXPECT_EQ(word.waiters.load(), 0);
+    semaphore.unlock();
+    EXPECT_EQ(word.value.load(), 1);
+}
+
+TEST_F(FutexSemaphoreTest, TestUnlockWakesWaitingThread) {
+    FutexSemaphore semaphore(&word, 0, true);
+    std::atomic<bool> acquired{false};
+    std::thread waiter([&] {
+        semaphore.lock();
+        acquired.store(true);
+    });
+    while (word.waiters.load() == 0) {
+        std::this_thread::yield();
+    }
+    EXPECT_FALSE(acquired.load());
+    semaphore.unlock();
+    waiter.join();
+    EXPECT_TRUE(acquired.load());
+    EXPECT_EQ(word.value.load(), 0);
+    EXPECT_EQ(word.waiters.load(), 0);
+}
+
+TEST_F(FutexSemaphoreTest, TestLockAllTakesTheWholeCounter) {
+    FutexSemaphore semaphore(&word, 0, true);
+    semaphore.unlock(3);
+    EXPECT_EQ(semaphore.lock_all(), 3);
+    EXPECT_EQ(word.value.load(), 0);
+}
+
+TEST_F(FutexSemaphoreTest, TestLockAllWaitsForUnlock) {
+    FutexSemaphore semaphore(&word, 0, true);
+    int taken = 0;
+    std::thread waiter([&] { taken = semaphore.lock_all(); });
+    while (word.waiters.load() == 0) {
+        std::this_thread::yield();
+    }
+    semaphore.unlock(2);
+    waiter.join();
+    EXPECT_EQ(taken, 2);
+}
+
+TEST_F(FutexSemaphoreTest, TestWaitersInOtherProcessesAreWokenUp) {
+    auto shared = static_cast<FutexWord *>(mmap(nullptr, sizeof(FutexWord), PROT_READ | PROT_WRITE,
+                                                MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+    ASSERT_NE(shared, MAP_FAILED);
+    FutexSemaphore semaphore(shared, 0, true);
+
+    const pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        FutexSemaphore child(shared, 0, false);
+        for (int i = 0; i < 1000; ++i) {
+            child.lock();
+        }
+        _exit(0);
+    }
+    for (int i = 0; i < 1000; ++i) {
+        semaphore.unlock();
+    }
+    int status;
+    EXPECT_EQ(waitpid(pid, &status, 0), pid);
+    EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    EXPECT_EQ(shared->value.load(), 0);
+    munmap(shared, sizeof(FutexWord));
+}
+
+#endif // CAPIO_COMMON_UNIT_TESTS_FUTEX_SEMAPHORE_HPP
@@ -0,0 +1,84 @@
+#ifndef CAPIO_COMMON_UNIT_TESTS_MAILBOX_HPP
+#define CAPIO_COMMON_UNIT_TESTS_MAILBOX_HPP
+
+#include <string>
+#include <thread>
+
+#include <sys/wait.h>
+
+#include "capio/mailbox.hpp"
+
+class MailboxSlabTest : public testing::Test {
+  protected:
+    const std::string workflow = "capio_unit_tests_" + std::to_string(getpid());
+
+    // Pid of a process that already terminated
+    static pid_t dead_pid() {
+        const pid_t pid = fork();
+        if (pid == 0) {
+            _exit(0);
+        }
+        waitpid(pid, nullptr, 0);
+        return pid;
+    }
+};
+
+TEST_F(MailboxSlabTest, TestThreadsClaimDifferentMailboxes) {
+    MailboxSlab slab(4, workflow);
+    const int first  = slab.claim(100);
+    const int second = slab.claim(101);
+    EXPECT_NE(first, second);
+    EXPECT_EQ(slab.at(first, 100)->owner.load(), 100);
+    EXPECT_EQ(slab.at(second, 101)->owner.load(), 101);
+}
+
+TEST_F(MailboxSlabTest, TestReleasedMailboxIsClaimedAgain) {
+    MailboxSlab slab(1, workflow);
+    const int index = slab.claim(100);
+    MailboxSlab::release(slab.at(index, 100), 100);
+    EXPECT_EQ(slab.claim(101), index);
+}
+
+TEST_F(MailboxSlabTest, TestReleaseByAnotherThreadIsIgnored) {
+    MailboxSlab slab(1, workflow);
+    CapioMailbox *mailbox = slab.at(slab.claim(100), 100);
+    MailboxSlab::release(mailbox, 101);
+    EXPECT_EQ(mailbox->owner.load(), 100);
+}
+
+TEST_F(MailboxSlabTest, TestMailboxOfTerminatedOwnerIsReclaimed) {
+    MailboxSlab slab(2, workflow);
+    const pid_t dead  = dead_pid();
+    const int alive   = slab.claim(getpid());
+    const int stale   = slab.claim(dead);
+    const pid_t other = dead_pid();
+    // no mailbox is free: only the one of the terminated thread can be reclaimed
+    EXPECT_EQ(slab.claim(other), stale);
+    EXPECT_EQ(slab.at(alive, getpid())->owner.load(), getpid());
+    EXPECT_EQ(slab.at(stale, other)->owner.load(), other);
+}
+
+TEST_F(MailboxSlabTest, TestPostWakesUpWaitingOwner) {
+    MailboxSlab slab(1, workflow);
+    CapioMailbox *mailbox = slab.at(slab.claim(100), 100);
+    capio_off64_t value   = 0;
+    std::thread owner([&] { value = MailboxSlab::wait(mailbox); });
+    while (mailbox->ready.waiters.load() == 0) {
+        std::this_thread::yield();
+    }
+    MailboxSlab::post(mailbox, 42);
+    owner.join();
+    EXPECT_EQ(value, 42u);
+    EXPECT_EQ(mailbox->parks.load(), 1u);
+}
+
+TEST_F(MailboxSlabTest, TestReplyPostedWhileSpinningIsNotParked) {
+    MailboxSlab slab(1, workflow);
+    CapioMailbox *mailbox = slab.at(slab.claim(100), 100);
+    MailboxSlab::post(mailbox, 42);
+    EXPECT_EQ(MailboxSlab::wait(mailbox, 1000000), 42u);
+    EXPECT_EQ(mailbox->spin_hits.load(), 1u);
+    EXPECT_EQ(mailbox->parks.load(), 0u);
+}
+
+#endif // CAPIO_COMMON_UNIT_TESTS_MAILBOX_HPP
@@ -0,0 +1,18 @@
+#include <gtest/gtest.h>
+
+#include <climits>
+
+#include <unistd.h>
+
+char node_name[HOST_NAME_MAX];
+
+#include "framed_queue.hpp"
+#include "futex_semaphore.hpp"
+#include "mailbox.hpp"
+
+int main(int argc, char **argv) {
+    gethostname(node_name, HOST_NAME_MAX);
+    testing::InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+}
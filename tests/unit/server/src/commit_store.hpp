@@ -0,0 +1,97 @@
+#ifndef CAPIO_SERVER_UNIT_TESTS_COMMIT_STORE_HPP
+#define CAPIO_SERVER_UNIT_TESTS_COMMIT_STORE_HPP
+
+#include <thread>
+#include <vector>
+
+class CommitStoreTest : public testing::Test {
+  protected:
+    const std::filesystem::path path =
+        std::filesystem::temp_directory_path() /
+        ("capio_unit_tests_" + std::to_string(getpid()) + "_" + CAPIO_COMMIT_STORE_NAME);
+
+    void TearDown() override { std::filesystem::remove(path); }
+};
+
+TEST_F(CommitStoreTest, TestUnknownPathHasNoTokenAndNoCloses) {
+    CommitStore store(path);
+    EXPECT_FALSE(store.hasToken("/capio/file"));
+    EXPECT_EQ(store.getCloseCount("/capio/file"), 0);
+}
+
+TEST_F(CommitStoreTest, TestTokensAndCloseCountsArePerPath) {
+    CommitStore store(path);
+    store.setToken("/capio/a");
+    store.increaseCloseCount("/capio/b");
+    store.increaseCloseCount("/capio/b");
+
+    EXPECT_TRUE(store.hasToken("/capio/a"));
+    EXPECT_EQ(store.getCloseCount("/capio/a"), 0);
+    EXPECT_FALSE(store.hasToken("/capio/b"));
+    EXPECT_EQ(store.getCloseCount("/capio/b"), 2);
+}
+
+TEST_F(CommitStoreTest, TestStoreIsSharedAndPersistent) {
+    {
+        CommitStore first(path);
+        CommitStore second(path);
+        first.setToken("/capio/a");
+        first.increaseCloseCount("/capio/a");
+        EXPECT_TRUE(second.hasToken("/capio/a"));
+        EXPECT_EQ(second.getCloseCount("/capio/a"), 1);
+    }
+    CommitStore reopened(path);
+    EXPECT_TRUE(reopened.hasToken("/capio/a"));
+    EXPECT_EQ(reopened.getCloseCount("/capio/a"), 1);
+}
+
+TEST_F(CommitStoreTest, TestConcurrentClaimsOfTheSameSlots) {
+    constexpr int nr_stores = 4, nr_paths = 200, nr_closes = 10;
+    // every store has its own descriptor, so their record locks conflict as between servers
+    std::vector<CommitStore *> stores;
+    for (int i = 0; i < nr_stores; ++i) {
+        stores.push_back(new CommitStore(path));
+    }
+    std::vector<std::thread> threads;
+    for (auto store : stores) {
+        threads.emplace_back([store] {
+            for (int round = 0; round < nr_closes; ++round) {
+                for (int i = 0; i < nr_paths; ++i) {
+                    store->increaseCloseCount("/capio/dir/file_" + std::to_string(i));
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    for (int i = 0; i < nr_paths; ++i) {
+        const std::string file = "/capio/dir/file_" + std::to_string(i);
+        for (auto store : stores) {
+            EXPECT_EQ(store->getCloseCount(file), nr_stores * nr_closes) << file;
+        }
+    }
+    for (auto store : stores) {
+        delete store;
+    }
+}
+
+TEST_F(CommitStoreTest, TestConcurrentClosesThroughTheSameStore) {
+    constexpr int nr_threads = 4, nr_closes = 100;
+    // the threads of a server share the descriptor, and thus its record locks
+    CommitStore store(path);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < nr_threads; ++i) {
+        threads.emplace_back([&store] {
+            for (int round = 0; round < nr_closes; ++round) {
+                store.increaseCloseCount("/capio/shared");
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(store.getCloseCount("/capio/shared"), nr_threads * nr_closes);
+}
+
+#endif // CAPIO_SERVER_UNIT_TESTS_COMMIT_STORE_HPP
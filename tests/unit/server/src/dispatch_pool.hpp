@@ -0,0 +1,92 @@
+#ifndef CAPIO_SERVER_UNIT_TESTS_DISPATCH_POOL_HPP
+#define CAPIO_SERVER_UNIT_TESTS_DISPATCH_POOL_HPP
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class DispatchPoolTest : public testing::Test {
+  protected:
+    static inline std::mutex mutex;
+    static inline std::vector<std::pair<int, int>> handled; // (tid, sequence number) of requests
+
+    void SetUp() override { handled.clear(); }
+
+    // Record the request, holding up the first of each thread to let later ones overtake it
+    static void record(const char *const buf, const long int size) {
+        int tid, seq;
+        memcpy(&tid, buf, sizeof(tid));
+        memcpy(&seq, buf + sizeof(tid), sizeof(seq));
+        if (seq == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        std::lock_guard<std::mutex> lg(mutex);
+        handled.emplace_back(tid, seq);
+    }
+
+    static void submit(DispatchPool &pool, std::size_t key, int tid, int seq) {
+        char buf[2 * sizeof(int)];
+        memcpy(buf, &tid, sizeof(tid));
+        memcpy(buf + sizeof(tid), &seq, sizeof(seq));
+        pool.submit(key, tid, record, buf, sizeof(buf));
+    }
+
+    // Wait until @param count requests have been handled
+    static void wait_handled(std::size_t count) {
+        for (int i = 0; i < 1000; ++i) {
+            {
+                std::lock_guard<std::mutex> lg(mutex);
+                if (handled.size() >= count) {
+                    return;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+};
+
+TEST_F(DispatchPoolTest, TestRequestsOfAThreadAreHandledInOrderAcrossWorkers) {
+    DispatchPool pool(4);
+    for (int seq = 0; seq < 16; ++seq) {
+        submit(pool, seq, 1, seq);
+    }
+    wait_handled(16);
+
+    std::lock_guard<std::mutex> lg(mutex);
+    ASSERT_EQ(handled.size(), 16u);
+    for (int seq = 0; seq < 16; ++seq) {
+        EXPECT_EQ(handled[seq], std::make_pair(1, seq));
+    }
+}
+
+TEST_F(DispatchPoolTest, TestThreadsDoNotWaitForEachOther) {
+    DispatchPool pool(2);
+    submit(pool, 0, 1, 0);
+    submit(pool, 1, 2, 1);
+    wait_handled(2);
+
+    std::lock_guard<std::mutex> lg(mutex);
+    ASSERT_EQ(handled.size(), 2u);
+    EXPECT_EQ(handled[0], std::make_pair(2, 1));
+    EXPECT_EQ(handled[1], std::make_pair(1, 0));
+}
+
+TEST_F(DispatchPoolTest, TestRequestsOfManyThreadsKeepTheirOrder) {
+    DispatchPool pool(4);
+    for (int seq = 0; seq < 64; ++seq) {
+        for (int tid = 1; tid <= 8; ++tid) {
+            submit(pool, tid * 7 + seq * 3, tid, seq);
+        }
+    }
+    wait_handled(8 * 64);
+
+    std::lock_guard<std::mutex> lg(mutex);
+    ASSERT_EQ(handled.size(), 8u * 64);
+    std::vector<int> next(9, 0);
+    for (const auto &[tid, seq] : handled) {
+        EXPECT_EQ(seq, next[tid]++) << "thread " << tid;
+    }
+}
+
+#endif // CAPIO_SERVER_UNIT_TESTS_DISPATCH_POOL_HPP
@@ -0,0 +1,316 @@
+#ifndef CAPIO_SERVER_UNIT_TESTS_FILE_MANAGER_HPP
+#define CAPIO_SERVER_UNIT_TESTS_FILE_MANAGER_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <thread>
+
+/**
+ * Client thread waiting on the file manager, as a client library would: it reads the reply of the
+ * server from its mailbox, and then waits on the wake board if the reply is a ticket
+ */
+struct TestWaiter {
+    pid_t tid;
+    CapioMailbox *mailbox;
+    std::thread *thread = nullptr;
+    std::atomic<bool> done{false};
+    capio_off64_t value = 0;
+};
+
+class FileManagerTest : public testing::Test {
+  protected:
+    static inline MailboxSlab *mailboxes;
+    static inline WakeBoard *board;
+    static inline pid_t next_tid = 4000000;
+
+    static void SetUpTestSuite() {
+        capio_cl_engine = JsonParser::parse("");
+        client_manager  = new ClientManager();
+        fs_monitor      = new FileSystemMonitor();
+        file_manager    = new CapioFileManager();
+        mailboxes       = new MailboxSlab(CAPIO_MAILBOX_SLAB_SIZE, workflow_name, false);
+        board           = new WakeBoard(CAPIO_WAKE_BOARD_SLOTS, workflow_name, false);
+    }
+
+    static void TearDownTestSuite() {
+        delete board;
+        delete mailboxes;
+        delete fs_monitor;
+        delete file_manager;
+        delete client_manager;
+        delete capio_cl_engine;
+    }
+
+    // Path of @param name in CAPIO_DIR, with the rules of a file produced by some application
+    static std::string file(const std::string &name,
+                            const std::string &fire_rule = CAPIO_FILE_MODE_UPDATE) {
+        const std::string path = get_capio_dir() / name;
+        capio_cl_engine->newFile(path);
+        capio_cl_engine->setFireRule(path, fire_rule);
+        return path;
+    }
+
+    // Grow @param path to @param size bytes on the file system
+    // Directory @param name in CAPIO_DIR, committed once it holds @param count files
+    static std::string directory(const std::string &name, long count) {
+        const std::string path = get_capio_dir() / name;
+        std::filesystem::create_directories(path);
+        capio_cl_engine->newFile(path);
+        capio_cl_engine->setDirectoryFileCount(path, count);
+        return path;
+    }
+
+    static void write(const std::string &path, std::uintmax_t size) {
+        std::ofstream out(path, std::ios::app);
+        out << std::string(size - std::filesystem::file_size(path), 'x');
+    }
+
+    /**
+     * Make a new client thread of application @param app wait for @param condition on @param path,
+     * for @param offset
+     * @return the waiter, to be given to woken() and then to release()
+     */
+    static TestWaiter *await(CapioWaitCondition condition, const std::string &path,
+                             capio_off64_t offset = 0, const std::string &app = "app") {
+        auto waiter     = new TestWaiter();
+        waiter->tid     = next_tid++;
+        const int index = mailboxes->claim(waiter->tid);
+        waiter->mailbox = mailboxes->at(index, waiter->tid);
+        client_manager->register_new_client(waiter->tid, index, app);
+        file_manager->await(condition, path, waiter->tid, offset);
+        waiter->thread = new std::thread([waiter, offset] {
+            capio_off64_t value = MailboxSlab::wait(waiter->mailbox);
+            if (WakeBoard::is_ticket(value)) {
+                value = board->wait(value, offset, waiter->mailbox);
+            }
+            waiter->value = value;
+            waiter->done.store(true);
+        });
+        return waiter;
+    }
+
+    // Whether @param waiter is woken up within a second
+    static bool woken(const TestWaiter *waiter) {
+        for (int i = 0; i < 1000 && !waiter->done.load(); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return waiter->done.load();
+    }
+
+    // Whether @param waiter is still waiting after a while
+    static bool waiting(const TestWaiter *waiter) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        return !waiter->done.load();
+    }
+
+    static void release(TestWaiter *waiter) {
+        waiter->thread->join();
+        delete waiter->thread;
+        client_manager->remove_client(waiter->tid);
+        delete waiter;
+    }
+};
+
+TEST_F(FileManagerTest, TestDataWaitersAreWokenInOffsetOrder) {
+    const auto path = file("heap_fnu", CAPIO_FILE_MODE_NO_UPDATE);
+    write(path, 10);
+    auto far    = await(CAPIO_WAIT_DATA, path, 300);
+    auto near   = await(CAPIO_WAIT_DATA, path, 100);
+    auto middle = await(CAPIO_WAIT_DATA, path, 200);
+    EXPECT_TRUE(waiting(near));
+
+    write(path, 150);
+    file_manager->fileChanged(path);
+    ASSERT_TRUE(woken(near));
+    EXPECT_EQ(near->value, 150u);
+    EXPECT_TRUE(waiting(middle));
+    EXPECT_TRUE(waiting(far));
+
+    write(path, 250);
+    file_manager->fileChanged(path);
+    ASSERT_TRUE(woken(middle));
+    EXPECT_EQ(middle->value, 250u);
+    EXPECT_TRUE(waiting(far));
+    EXPECT_TRUE(file_manager->hasThreadAwaitingData(path));
+
+    file_manager->setCommitted(path);
+    ASSERT_TRUE(woken(far));
+    EXPECT_EQ(far->value, ULLONG_MAX);
+    EXPECT_FALSE(file_manager->hasThreadAwaitingData(path));
+    for (auto waiter : {near, middle, far}) {
+        release(waiter);
+    }
+}
+
+TEST_F(FileManagerTest, TestDataWaitersOfUpdatedFilesWaitForTheCommit) {
+    const auto path = file("heap_update");
+    auto first      = await(CAPIO_WAIT_DATA, path, 10);
+    auto second     = await(CAPIO_WAIT_DATA, path, 1000);
+
+    write(path, 2000);
+    file_manager->fileChanged(path);
+    EXPECT_TRUE(waiting(first));
+    EXPECT_TRUE(waiting(second));
+
+    file_manager->setCommitted(path);
+    ASSERT_TRUE(woken(first));
+    ASSERT_TRUE(woken(second));
+    EXPECT_EQ(first->value, ULLONG_MAX);
+    EXPECT_EQ(second->value, ULLONG_MAX);
+    EXPECT_FALSE(file_manager->hasThreadAwaitingData(path));
+    release(first);
+    release(second);
+}
+
+TEST_F(FileManagerTest, TestDataWaitersOfACommittedFileAreWokenRightAway) {
+    const auto path = file("heap_committed");
+    write(path, 100);
+    file_manager->setCommitted(path);
+
+    auto waiter = await(CAPIO_WAIT_DATA, path, 1000);
+    ASSERT_TRUE(woken(waiter));
+    EXPECT_EQ(waiter->value, ULLONG_MAX);
+    EXPECT_FALSE(file_manager->hasThreadAwaitingData(path));
+    release(waiter);
+}
+
+TEST_F(FileManagerTest, TestDirectoriesCountTheFilesTheServerLearnsOf) {
+    const auto dir = directory("count_known", 2);
+    EXPECT_FALSE(file_manager->isCommitted(dir));
+
+    write(dir + "/a", 1);
+    file_manager->setCreated(dir + "/a");
+    EXPECT_FALSE(file_manager->isCommitted(dir));
+
+    // files the server does not know of are found by the next scan only
+    write(dir + "/b", 1);
+    EXPECT_FALSE(file_manager->isCommitted(dir));
+    file_manager->setExists(dir + "/b");
+    EXPECT_TRUE(file_manager->isCommitted(dir));
+}
+
+TEST_F(FileManagerTest, TestFilesCreatedAgainAreCountedOnce) {
+    const auto dir = directory("count_again", 2);
+    EXPECT_FALSE(file_manager->isCommitted(dir));
+    write(dir + "/a", 1);
+    write(dir + "/b", 1);
+
+    // counting a twice would make a scan find b as well
+    file_manager->setCreated(dir + "/a");
+    file_manager->setCreated(dir + "/a");
+    EXPECT_FALSE(file_manager->isCommitted(dir));
+}
+
+TEST_F(FileManagerTest, TestRemovedAndMovedFilesAreNoLongerCounted) {
+    const auto dir = directory("count_removed", 2);
+    EXPECT_FALSE(file_manager->isCommitted(dir));
+    write(dir + "/a", 1);
+    write(dir + "/b", 1);
+
+    file_manager->setCreated(dir + "/c");
+    file_manager->setRemoved(dir + "/c");
+    file_manager->setCreated(dir + "/d");
+    EXPECT_FALSE(file_manager->isCommitted(dir));
+
+    file_manager->renameState(dir + "/d", get_capio_dir() / "count_moved");
+    file_manager->setCreated(dir + "/e");
+    EXPECT_FALSE(file_manager->isCommitted(dir));
+}
+
+TEST_F(FileManagerTest, TestDirectoryWaitersAreWokenByTheLastFile) {
+    const auto dir = directory("count_waited", 2);
+    auto waiter    = await(CAPIO_WAIT_DATA, dir);
+    EXPECT_TRUE(waiting(waiter));
+
+    write(dir + "/a", 1);
+    file_manager->setCreated(dir + "/a");
+    file_manager->fileChanged(dir + "/a");
+    EXPECT_TRUE(waiting(waiter));
+
+    write(dir + "/b", 1);
+    file_manager->setCreated(dir + "/b");
+    file_manager->fileChanged(dir + "/b");
+    ASSERT_TRUE(woken(waiter));
+    EXPECT_EQ(waiter->value, ULLONG_MAX);
+    release(waiter);
+}
+
+TEST_F(FileManagerTest, TestCreationWaitersAreWokenByFileCreated) {
+    const std::string path = get_capio_dir() / "created";
+    auto first             = await(CAPIO_WAIT_CREATION, path);
+    auto second            = await(CAPIO_WAIT_CREATION, path);
+    EXPECT_TRUE(waiting(first));
+    const auto awaited = file_manager->getFileAwaitingCreation();
+    EXPECT_NE(std::find(awaited.begin(), awaited.end(), path), awaited.end());
+
+    write(path, 1);
+    file_manager->setCreated(path);
+    EXPECT_FALSE(file_manager->fileCreated(path));
+    ASSERT_TRUE(woken(first));
+    ASSERT_TRUE(woken(second));
+    EXPECT_EQ(first->value, 1u);
+    EXPECT_EQ(second->value, 1u);
+    EXPECT_TRUE(file_manager->getFileAwaitingCreation().empty());
+    release(first);
+    release(second);
+}
+
+TEST_F(FileManagerTest, TestFileCreatedReportsTheDataWaitersOfTheFileAndItsDirectory) {
+    const auto path = file("created_data");
+    auto waiter     = await(CAPIO_WAIT_DATA, path, 10);
+    EXPECT_TRUE(file_manager->fileCreated(path));
+    file_manager->setCommitted(path);
+    ASSERT_TRUE(woken(waiter));
+    release(waiter);
+    EXPECT_FALSE(file_manager->fileCreated(path));
+
+    const auto dir = directory("created_dir", 1);
+    waiter         = await(CAPIO_WAIT_DATA, dir);
+    EXPECT_TRUE(file_manager->fileCreated(dir + "/a"));
+    write(dir + "/a", 1);
+    file_manager->setCreated(dir + "/a");
+    file_manager->fileChanged(dir + "/a");
+    ASSERT_TRUE(woken(waiter));
+    EXPECT_TRUE(file_manager->getFileAwaitingData().empty());
+    release(waiter);
+}
+
+TEST_F(FileManagerTest, TestWaitersOfSatisfiedConditionsAreWokenRightAway) {
+    const auto path = file("satisfied", CAPIO_FILE_MODE_NO_UPDATE);
+    write(path, 100);
+
+    auto creation = await(CAPIO_WAIT_CREATION, path);
+    ASSERT_TRUE(woken(creation));
+    EXPECT_EQ(creation->value, 1u);
+
+    auto data = await(CAPIO_WAIT_DATA, path, 50);
+    ASSERT_TRUE(woken(data));
+    EXPECT_EQ(data->value, 100u);
+    EXPECT_TRUE(file_manager->getFileAwaitingCreation().empty());
+    EXPECT_FALSE(file_manager->hasThreadAwaitingData(path));
+    release(creation);
+    release(data);
+}
+
+TEST_F(FileManagerTest, TestProducersAreWokenBeforeTheCommit) {
+    const auto path = file("produced");
+    auto consumer   = await(CAPIO_WAIT_DATA, path, 10, "consumer");
+    auto producer   = await(CAPIO_WAIT_DATA, path, 10, "producer");
+    std::string app = "producer";
+    capio_cl_engine->addProducer(path, app);
+    write(path, 50);
+
+    file_manager->unlockProducersAwaitingData(path);
+    ASSERT_TRUE(woken(producer));
+    EXPECT_EQ(producer->value, 50u);
+    EXPECT_TRUE(waiting(consumer));
+
+    file_manager->setCommitted(path);
+    ASSERT_TRUE(woken(consumer));
+    EXPECT_EQ(consumer->value, ULLONG_MAX);
+    release(consumer);
+    release(producer);
+}
+
+#endif // CAPIO_SERVER_UNIT_TESTS_FILE_MANAGER_HPP
@@ -0,0 +1,40 @@
+#include <gtest/gtest.h>
+
+#include <climits>
+#include <singleheader/simdjson.h>
+#include <unistd.h>
+
+#include <string>
+
+std::string workflow_name;
+char node_name[HOST_NAME_MAX];
+
+#include "utils/types.hpp"
+
+#include "capio/env.hpp"
+#include "capio/logger.hpp"
+#include "utils/common.hpp"
+
+#include "client-manager/request_handler_engine.hpp"
+#include "file-manager/file_manager.hpp"
+
+#include "commit_store.hpp"
+#include "dispatch_pool.hpp"
+#include "file_manager.hpp"
+#include "request_stats.hpp"
+#include "wake_board.hpp"
+#include "write_coalescer.hpp"
+
+int main(int argc, char **argv) {
+    gethostname(node_name, HOST_NAME_MAX);
+    workflow_name = "capio_unit_tests_" + std::to_string(getpid());
+    // files created by the tests live in a private CAPIO_DIR
+    const auto capio_dir = std::filesystem::temp_directory_path() / workflow_name;
+    std::filesystem::create_directories(capio_dir);
+    setenv("CAPIO_DIR", capio_dir.c_str(), 1);
+    testing::InitGoogleTest(&argc, argv);
+
+    const int result = RUN_ALL_TESTS();
+    std::filesystem::remove_all(capio_dir);
+    return result;
+}
@@ -0,0 +1,96 @@
+#ifndef CAPIO_SERVER_UNIT_TESTS_REQUEST_STATS_HPP
+#define CAPIO_SERVER_UNIT_TESTS_REQUEST_STATS_HPP
+
+#include <string>
+#include <vector>
+
+TEST(LatencyHistogramTest, TestSmallValuesAreCountedExactly) {
+    LatencyHistogram histogram;
+    for (unsigned long long value = 0; value < 8; ++value) {
+        histogram.record(value);
+    }
+    EXPECT_EQ(histogram.count(), 8u);
+    EXPECT_EQ(histogram.mean(), 3u);
+    EXPECT_EQ(histogram.max(), 7u);
+    EXPECT_EQ(histogram.percentile(125), 0u);
+    EXPECT_EQ(histogram.percentile(500), 3u);
+    EXPECT_EQ(histogram.percentile(1000), 7u);
+}
+
+TEST(LatencyHistogramTest, TestPercentilesAreBoundedByTheRelativeError) {
+    for (unsigned long long value : {8ULL, 9ULL, 100ULL, 1000ULL, 123456ULL, 987654321ULL}) {
+        LatencyHistogram histogram;
+        histogram.record(value);
+        histogram.record(value * 4);
+        // the upper bound of the bucket of a value exceeds it by less than 1 / 8
+        const unsigned long long bound = histogram.percentile(500);
+        EXPECT_GE(bound, value);
+        EXPECT_LT(bound, value + value / 8 + 1);
+        EXPECT_EQ(histogram.percentile(1000), value * 4);
+    }
+}
+
+TEST(LatencyHistogramTest, TestValuesOfTheSameBucketShareTheirBound) {
+    LatencyHistogram histogram;
+    // 1024 to 1151 fall in the same bucket, 1152 in the next one
+    histogram.record(1024);
+    histogram.record(1151);
+    histogram.record(1152);
+    histogram.record(5000);
+    EXPECT_EQ(histogram.percentile(250), 1151u);
+    EXPECT_EQ(histogram.percentile(500), 1151u);
+    EXPECT_EQ(histogram.percentile(750), 1279u);
+}
+
+TEST(LatencyHistogramTest, TestHugeValuesShareTheLastBucket) {
+    LatencyHistogram histogram;
+    histogram.record(1ULL << 41);
+    histogram.record(1ULL << 50);
+    EXPECT_EQ(histogram.count(), 2u);
+    EXPECT_EQ(histogram.max(), 1ULL << 50);
+    EXPECT_EQ(histogram.percentile(500), 1ULL << 50);
+}
+
+TEST(LatencyHistogramTest, TestEmptyHistogramReportsZero) {
+    LatencyHistogram histogram;
+    EXPECT_EQ(histogram.count(), 0u);
+    EXPECT_EQ(histogram.mean(), 0u);
+    EXPECT_EQ(histogram.percentile(990), 0u);
+}
+
+TEST(StatsLineTest, TestNumbersAndStringsAreFormatted) {
+    StatsLine<64> line;
+    line << "a " << 0ULL << " b " << 1234567890ULL << " " << ULLONG_MAX;
+    EXPECT_STREQ(line.c_str(), "a 0 b 1234567890 18446744073709551615");
+    line.clear();
+    EXPECT_STREQ(line.c_str(), "");
+}
+
+TEST(StatsLineTest, TestTextThatDoesNotFitIsDropped) {
+    StatsLine<8> line;
+    line << "abcd" << 123456ULL;
+    EXPECT_STREQ(line.c_str(), "abcd123");
+    EXPECT_EQ(line.size(), 7u);
+}
+
+TEST(RequestStatsTest, TestStatisticsArePrintedByCode) {
+    RequestStats stats;
+    stats.queued(CAPIO_REQUEST_READ, 100);
+    stats.served(CAPIO_REQUEST_READ, -5);
+    stats.parked();
+    stats.woken(3);
+    stats.coalesced();
+    stats.coalesced();
+
+    std::vector<std::string> lines;
+    stats.print([&lines](const char *line) { lines.emplace_back(line); });
+    ASSERT_EQ(lines.size(), 4u);
+    EXPECT_EQ(lines[0], "read queue: 1 requests, mean 100 ns, p50 100 ns, p90 100 ns, p99 100 ns, "
+                        "max 100 ns");
+    EXPECT_EQ(lines[1], "read service: 1 requests, mean 0 ns, p50 0 ns, p90 0 ns, p99 0 ns, "
+                        "max 0 ns");
+    EXPECT_EQ(lines[2], "Threads parked waiting for a file: 1, woken up: 3");
+    EXPECT_EQ(lines[3], "Write notifications merged into a later one: 2");
+}
+
+#endif // CAPIO_SERVER_UNIT_TESTS_REQUEST_STATS_HPP
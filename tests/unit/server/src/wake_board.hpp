@@ -0,0 +1,168 @@
+#ifndef CAPIO_SERVER_UNIT_TESTS_WAKE_BOARD_HPP
+#define CAPIO_SERVER_UNIT_TESTS_WAKE_BOARD_HPP
+
+#include <chrono>
+#include <thread>
+
+// The board has as many slots as a file can be found in, so every file can use all of them
+class WakeBoardTest : public testing::Test {
+  protected:
+    WakeBoard *board       = nullptr;
+    MailboxSlab *mailboxes = nullptr;
+    pid_t next_tid         = 5000000;
+
+    void SetUp() override {
+        board     = new WakeBoard(CAPIO_WAKE_BOARD_PROBES, workflow_name + "_board");
+        mailboxes = new MailboxSlab(CAPIO_MAILBOX_SLAB_SIZE, workflow_name + "_board");
+    }
+
+    void TearDown() override {
+        delete mailboxes;
+        delete board;
+    }
+
+    // Mailbox of a new client thread
+    CapioMailbox *mailbox() {
+        const pid_t tid = next_tid++;
+        return mailboxes->at(mailboxes->claim(tid), tid);
+    }
+
+    // Index of the slot of @param ticket
+    static int slot(capio_off64_t ticket) { return static_cast<int>((ticket >> 32) & INT_MAX); }
+
+    // Wait on @param ticket in a new thread, storing the value in @param value and then @param done
+    std::thread *wait(capio_off64_t ticket, capio_off64_t need, std::atomic<bool> &done,
+                      capio_off64_t &value) {
+        CapioMailbox *box = mailbox();
+        return new std::thread([this, ticket, need, box, &done, &value] {
+            value = board->wait(ticket, need, box);
+            done.store(true);
+        });
+    }
+
+    static bool woken(const std::atomic<bool> &done) {
+        for (int i = 0; i < 1000 && !done.load(); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return done.load();
+    }
+
+    static bool waiting(const std::atomic<bool> &done) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        return !done.load();
+    }
+
+    static void join(std::thread *thread) {
+        thread->join();
+        delete thread;
+    }
+};
+
+TEST_F(WakeBoardTest, TestSlotsAreClaimedOnlyWhenRequested) {
+    EXPECT_EQ(board->ticket("/tmp/file", CAPIO_WAKE_DATA, false), 0u);
+    EXPECT_EQ(board->find("/tmp/file", CAPIO_WAKE_DATA), -1);
+
+    const capio_off64_t first = board->ticket("/tmp/file", CAPIO_WAKE_DATA, true);
+    ASSERT_TRUE(WakeBoard::is_ticket(first));
+    EXPECT_EQ(board->find("/tmp/file", CAPIO_WAKE_DATA), slot(first));
+
+    const capio_off64_t second = board->ticket("/tmp/file", CAPIO_WAKE_DATA, false);
+    ASSERT_TRUE(WakeBoard::is_ticket(second));
+    EXPECT_EQ(slot(second), slot(first));
+
+    const capio_off64_t creation = board->ticket("/tmp/file", CAPIO_WAKE_CREATION, true);
+    ASSERT_TRUE(WakeBoard::is_ticket(creation));
+    EXPECT_NE(slot(creation), slot(first));
+    EXPECT_EQ(board->find("/tmp/other", CAPIO_WAKE_DATA), -1);
+}
+
+TEST_F(WakeBoardTest, TestAnnouncementsWakeTheWaitersTheySatisfy) {
+    const capio_off64_t near = board->ticket("/tmp/file", CAPIO_WAKE_DATA, true);
+    const capio_off64_t far  = board->ticket("/tmp/file", CAPIO_WAKE_DATA, false);
+    std::atomic<bool> near_done{false}, far_done{false};
+    capio_off64_t near_value = 0, far_value = 0;
+    auto near_thread = wait(near, 100, near_done, near_value);
+    auto far_thread  = wait(far, 1000, far_done, far_value);
+    EXPECT_TRUE(waiting(near_done));
+
+    board->announce(slot(near), 500);
+    ASSERT_TRUE(woken(near_done));
+    EXPECT_EQ(near_value, 500u);
+    EXPECT_TRUE(waiting(far_done));
+
+    board->announce(slot(far), ULLONG_MAX);
+    ASSERT_TRUE(woken(far_done));
+    EXPECT_EQ(far_value, ULLONG_MAX);
+    join(near_thread);
+    join(far_thread);
+}
+
+TEST_F(WakeBoardTest, TestAnnouncementsBeforeTheTicketAreIgnored) {
+    const int index = slot(board->ticket("/tmp/file", CAPIO_WAKE_DATA, true));
+    board->announce(index, 500);
+
+    const capio_off64_t ticket = board->ticket("/tmp/file", CAPIO_WAKE_DATA, false);
+    std::atomic<bool> done{false};
+    capio_off64_t value = 0;
+    auto thread         = wait(ticket, 100, done, value);
+    EXPECT_TRUE(waiting(done));
+
+    board->announce(index, 200);
+    ASSERT_TRUE(woken(done));
+    EXPECT_EQ(value, 200u);
+    join(thread);
+}
+
+TEST_F(WakeBoardTest, TestKickedWaitersReadTheirMailbox) {
+    const capio_off64_t ticket = board->ticket("/tmp/file", CAPIO_WAKE_DATA, true);
+    CapioMailbox *box          = mailbox();
+    std::atomic<bool> done{false};
+    capio_off64_t value = 0;
+    std::thread thread([&] {
+        value = board->wait(ticket, 100, box);
+        done.store(true);
+    });
+    board->kick(slot(ticket));
+    EXPECT_TRUE(waiting(done));
+
+    MailboxSlab::post(box, 42);
+    board->kick(slot(ticket));
+    ASSERT_TRUE(woken(done));
+    EXPECT_EQ(value, 42u);
+    thread.join();
+}
+
+TEST_F(WakeBoardTest, TestSlotsAreReusedOnceTheirWaitersLeave) {
+    std::vector<capio_off64_t> tickets;
+    for (int i = 0; i < CAPIO_WAKE_BOARD_PROBES; ++i) {
+        tickets.push_back(board->ticket("/tmp/file_" + std::to_string(i), CAPIO_WAKE_DATA, true));
+        ASSERT_TRUE(WakeBoard::is_ticket(tickets.back()));
+    }
+    EXPECT_EQ(board->ticket("/tmp/late", CAPIO_WAKE_DATA, true), 0u);
+
+    // a file whose waiter did not leave yet keeps its slot
+    const int index = slot(tickets[7]);
+    board->announce(index, 10);
+    EXPECT_EQ(board->ticket("/tmp/late", CAPIO_WAKE_DATA, true), 0u);
+    EXPECT_EQ(board->find("/tmp/file_7", CAPIO_WAKE_DATA), index);
+
+    std::atomic<bool> done{false};
+    capio_off64_t value = 0;
+    join(wait(tickets[7], 10, done, value));
+    const capio_off64_t late = board->ticket("/tmp/late", CAPIO_WAKE_DATA, true);
+    ASSERT_TRUE(WakeBoard::is_ticket(late));
+    EXPECT_EQ(slot(late), index);
+    EXPECT_EQ(board->find("/tmp/late", CAPIO_WAKE_DATA), index);
+    EXPECT_EQ(board->find("/tmp/file_7", CAPIO_WAKE_DATA), -1);
+
+    // the new file only sees the announcements made after its ticket
+    done.store(false);
+    auto thread = wait(late, 1, done, value);
+    EXPECT_TRUE(waiting(done));
+    board->announce(index, 20);
+    ASSERT_TRUE(woken(done));
+    EXPECT_EQ(value, 20u);
+    join(thread);
+}
+
+#endif // CAPIO_SERVER_UNIT_TESTS_WAKE_BOARD_HPP
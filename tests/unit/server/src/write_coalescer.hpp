@@ -0,0 +1,77 @@
+#ifndef CAPIO_SERVER_UNIT_TESTS_WRITE_COALESCER_HPP
+#define CAPIO_SERVER_UNIT_TESTS_WRITE_COALESCER_HPP
+
+#include <tuple>
+
+class WriteCoalescerTest : public testing::Test {
+  protected:
+    WriteCoalescer coalescer;
+    std::vector<char> buf = std::vector<char>(CAPIO_REQ_MAX_SIZE);
+
+    // Encode a write of @param count bytes by thread @param tid on @param fd and hold it back
+    bool hold(pid_t tid, int fd, const std::string &path, capio_off64_t count) {
+        WriteRequest req{};
+        req.header.tid = tid;
+        req.fd         = fd;
+        req.write_size = count;
+        const CapioRequestStrings<WriteRequest> strs{path};
+        capio_encode_request(buf.data(), req, strs);
+        const auto size = static_cast<long int>(capio_request_size<WriteRequest>(strs));
+        CapioRequestView<WriteRequest> request{};
+        EXPECT_TRUE(capio_decode_request(buf.data(), size, &request));
+        return coalescer.hold(request, buf.data(), size);
+    }
+
+    // Thread, file descriptor, path and write size of the notifications passed on by a flush
+    std::vector<std::tuple<pid_t, int, std::string, capio_off64_t>> flush() {
+        std::vector<std::tuple<pid_t, int, std::string, capio_off64_t>> flushed;
+        coalescer.flush([&](const CapioRequestHeader &header, const char *buf, long int size) {
+            CapioRequestView<WriteRequest> request{};
+            EXPECT_TRUE(capio_decode_request(buf, size, &request));
+            EXPECT_EQ(header.tid, request->header.tid);
+            flushed.emplace_back(header.tid, request->fd, request.str[0], request->write_size);
+        });
+        return flushed;
+    }
+};
+
+TEST_F(WriteCoalescerTest, TestWritesOfAThreadOnAFileAreMergedWithTheirSizes) {
+    EXPECT_FALSE(hold(100, 3, "/tmp/file", 10));
+    EXPECT_TRUE(hold(100, 3, "/tmp/file", 20));
+    EXPECT_TRUE(hold(100, 3, "/tmp/file", 30));
+    EXPECT_EQ(coalescer.size(), 1u);
+
+    const auto flushed = flush();
+    ASSERT_EQ(flushed.size(), 1u);
+    EXPECT_EQ(flushed[0], std::make_tuple(100, 3, std::string("/tmp/file"), 60ULL));
+    EXPECT_EQ(coalescer.size(), 0u);
+}
+
+TEST_F(WriteCoalescerTest, TestWritesOfOtherThreadsDescriptorsOrPathsAreNotMerged) {
+    EXPECT_FALSE(hold(100, 3, "/tmp/file", 10));
+    EXPECT_FALSE(hold(101, 3, "/tmp/file", 20));
+    EXPECT_FALSE(hold(100, 4, "/tmp/file", 30));
+    EXPECT_FALSE(hold(100, 3, "/tmp/other", 40));
+    EXPECT_TRUE(hold(101, 3, "/tmp/file", 5));
+
+    const auto flushed = flush();
+    ASSERT_EQ(flushed.size(), 4u);
+    // in the order they were first received
+    EXPECT_EQ(flushed[0], std::make_tuple(100, 3, std::string("/tmp/file"), 10ULL));
+    EXPECT_EQ(flushed[1], std::make_tuple(101, 3, std::string("/tmp/file"), 25ULL));
+    EXPECT_EQ(flushed[2], std::make_tuple(100, 4, std::string("/tmp/file"), 30ULL));
+    EXPECT_EQ(flushed[3], std::make_tuple(100, 3, std::string("/tmp/other"), 40ULL));
+}
+
+TEST_F(WriteCoalescerTest, TestWritesAreNotMergedAcrossFlushes) {
+    EXPECT_FALSE(hold(100, 3, "/tmp/file", 10));
+    EXPECT_EQ(flush().size(), 1u);
+    EXPECT_TRUE(flush().empty());
+
+    EXPECT_FALSE(hold(100, 3, "/tmp/longer_file", 20));
+    const auto flushed = flush();
+    ASSERT_EQ(flushed.size(), 1u);
+    EXPECT_EQ(flushed[0], std::make_tuple(100, 3, std::string("/tmp/longer_file"), 20ULL));
+}
+
+#endif // CAPIO_SERVER_UNIT_TESTS_WRITE_COALESCER_HPP